@@ -0,0 +1,738 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/batch_scanner.h>
+#include <pstiff/TiffWalker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        namespace
+        {
+            /** Payloads on their way from the reading to the parsing
+                threads. Bounded, so a slow callback stalls the reads
+                instead of piling up memory.
+             */
+
+            class Queue_t {
+            public:
+                Queue_t(size_t n) : _max(std::max<size_t>(n,1)),_closed(false) {
+                }
+
+                void push(BatchScanner::Item_t && i) {
+                    std::unique_lock<std::mutex> l(_m);
+                    _full.wait(l,[this] { return _q.size()<_max; });
+                    _q.push_back(std::move(i));
+                    _empty.notify_one();
+                }
+
+                bool pop(BatchScanner::Item_t & i) {
+                    std::unique_lock<std::mutex> l(_m);
+                    _empty.wait(l,[this] { return !_q.empty() || _closed; });
+
+                    if(_q.empty())
+                        return false;
+
+                    i = std::move(_q.front());
+                    _q.pop_front();
+                    _full.notify_one();
+
+                    return true;
+                }
+
+                void close() {
+                    std::lock_guard<std::mutex> l(_m);
+                    _closed = true;
+                    _empty.notify_all();
+                }
+
+            private:
+                std::mutex                       _m;
+                std::condition_variable          _full;
+                std::condition_variable          _empty;
+                std::deque<BatchScanner::Item_t> _q;
+                size_t                           _max;
+                bool                             _closed;
+            };
+
+            /** Runs the workers for as long as it lives
+             */
+
+            class Workers_t {
+            public:
+                Workers_t(unsigned n,size_t q,const BatchScanner::Callback_t & f) : _q(q) {
+                    for(unsigned i=0;i<std::max(n,1u);i++)
+                        _t.emplace_back([this,&f] {
+                            BatchScanner::Item_t i;
+                            while(_q.pop(i))
+                                f(i);
+                        });
+                }
+
+                ~Workers_t() {
+                    _q.close();
+                    for(std::thread & t : _t)
+                        t.join();
+                }
+
+                Queue_t & get_queue() {
+                    return _q;
+                }
+
+            private:
+                Queue_t                  _q;
+                std::vector<std::thread> _t;
+            };
+
+            struct Counters_t {
+                Counters_t() : files(0),failed(0),requests(0),bytes(0),payloads(0) {
+                }
+
+                std::atomic<uint64_t> files;
+                std::atomic<uint64_t> failed;
+                std::atomic<uint64_t> requests;
+                std::atomic<uint64_t> bytes;
+                std::atomic<uint64_t> payloads;
+            };
+
+            /** One file on its way through header, directories and
+                Photoshop payloads. step() walks as far as the bytes
+                at hand allow and then asks for the next read.
+             */
+
+            class Job_t {
+            public:
+                typedef enum {
+                    Header,
+                    Directory,
+                    Entries,
+                    Payload,
+                    Done
+                } State_t;
+
+                Job_t() : _fd(-1) {
+                }
+
+                ~Job_t() {
+                    close();
+                }
+
+                bool start(size_t i,const std::string & path) {
+                    close();
+
+                    _index  = i;
+                    _path   = &path;
+                    _state  = Header;
+                    _page   = 0;
+                    _error  = 0;
+                    _status = ParseStatus();
+                    _seen.clear();
+                    _buf.clear();
+                    _buf_off = 0;
+                    _req_len = 0;
+
+                    struct stat st;
+
+                    if((_fd = ::open(path.c_str(),O_RDONLY|O_CLOEXEC))<0 || ::fstat(_fd,&st)!=0) {
+                        _error = errno;
+                        _state = Done;
+                        return false;
+                    }
+
+                    _size = st.st_size;
+
+                    return true;
+                }
+
+                void close() {
+                    if(_fd>=0)
+                        ::close(_fd);
+                    _fd = -1;
+                }
+
+                /** Returns false once the file is done, true with a
+                    pending read described by get_iovec()/get_offset().
+                 */
+
+                bool step(size_t ahead,Queue_t & q,Counters_t & c);
+
+                /** Feed back the result of the pending read, r bytes
+                    or -errno
+                 */
+
+                void complete(ssize_t r) {
+                    if(r<0) {
+                        fail(-r);
+                    } else if((size_t)r<_req_len) {
+                        fail(ParseStatus(ParseStatus::TruncatedData,_req_off+r));
+                    } else {
+                        _buf_off = _req_off;
+                    }
+                    _req_len = 0;
+                }
+
+                /** Hand out a failure, if any, and release the file
+                 */
+
+                void finish(Queue_t & q,Counters_t & c) {
+                    close();
+                    c.files++;
+
+                    if(_error==0 && _status)
+                        return;
+
+                    c.failed++;
+
+                    BatchScanner::Item_t i;
+
+                    i.file   = _index;
+                    i.page   = _page;
+                    i.error  = _error;
+                    i.status = _status;
+                    i.path   = _path;
+
+                    q.push(std::move(i));
+                }
+
+                int get_fd() const {
+                    return _fd;
+                }
+
+                uint64_t get_offset() const {
+                    return _req_off;
+                }
+
+                struct iovec * get_iovec() {
+                    _iov.iov_base = _buf.data();
+                    _iov.iov_len  = _req_len;
+                    return &_iov;
+                }
+
+            private:
+                void fail(int e) {
+                    _error = e;
+                    _state = Done;
+                }
+
+                void fail(const ParseStatus & s) {
+                    _status = s;
+                    _state  = Done;
+                }
+
+                /** Move on to the directory at off, the end of the
+                    chain for 0
+                 */
+
+                void enter(uint64_t off) {
+                    _dir   = off;
+                    _state = Directory;
+
+                    if(off==0)
+                        _state = Done;
+                    else if(off<_f.get_header_size() || _page>=TiffWalker::MaxDirectories || !_seen.insert(off).second)
+                        fail(ParseStatus(ParseStatus::BadDirectory,off));
+                }
+
+                /** The n bytes at off if they are in the buffer. Else
+                    NULL and either a read of at least n bytes gets
+                    prepared or, if they are not in the file, we fail.
+                 */
+
+                const Byte_t * have(uint64_t off,uint64_t n,size_t ahead,ParseStatus::Code_t e) {
+                    if(off>=_buf_off && off-_buf_off<=_buf.size() && n<=_buf.size()-(off-_buf_off))
+                        return _buf.data() + (off-_buf_off);
+
+                    if(off>_size || n>_size-off) {
+                        fail(ParseStatus(e,off));
+                        return NULL;
+                    }
+
+                    _req_off = off;
+                    _req_len = std::min<uint64_t>(std::max<uint64_t>(n,ahead),_size-off);
+                    _buf.resize(_req_len);
+
+                    return NULL;
+                }
+
+                int                 _fd;
+                size_t              _index;
+                const std::string * _path;
+                uint64_t            _size;
+                State_t             _state;
+                TiffFormat          _f;
+                size_t              _page;
+                uint64_t            _dir;
+                uint64_t            _count;
+                uint64_t            _next;
+                uint64_t            _ps_off;
+                uint64_t            _ps_len;
+                int                 _error;
+                ParseStatus         _status;
+                std::set<uint64_t>  _seen;
+                std::vector<Byte_t> _buf;
+                uint64_t            _buf_off;
+                uint64_t            _req_off;
+                size_t              _req_len;
+                struct iovec        _iov;
+            };
+
+            bool Job_t::step(size_t ahead,Queue_t & q,Counters_t & c) {
+                const Byte_t * p;
+
+                while(true) {
+                    switch(_state) {
+                    case Header:
+                        if((p = have(0,TiffFormat::MinHeaderSize,ahead,ParseStatus::BadTiffHeader))==NULL)
+                            break;
+
+                        // A BigTIFF header takes another 8 bytes
+
+                        if((p = have(0,TiffFormat::get_header_size(p),ahead,ParseStatus::BadTiffHeader))==NULL)
+                            break;
+
+                        {
+                            uint64_t    first;
+                            ParseStatus s = _f.read_header(p,TiffFormat::get_header_size(p),first);
+
+                            if(!s) {
+                                fail(s);
+                                break;
+                            }
+
+                            enter(first);
+                        }
+                        continue;
+
+                    case Directory:
+                        if((p = have(_dir,_f.get_count_size(),ahead,ParseStatus::BadDirectory))==NULL)
+                            break;
+
+                        _count = _f.get_count(p);
+                        _state = Entries;
+
+                        if(_count>_size/_f.get_entry_size())
+                            fail(ParseStatus(ParseStatus::BadDirectory,_dir));
+                        continue;
+
+                    case Entries:
+                        if((p = have(_dir+_f.get_count_size(),_f.get_directory_size(_count)-_f.get_count_size(),ahead,ParseStatus::BadDirectory))==NULL)
+                            break;
+
+                        _next   = _f.get_word(p+_count*_f.get_entry_size());
+                        _ps_len = 0;
+
+                        for(uint64_t i=0;i<_count;i++) {
+                            const Byte_t * e = p+i*_f.get_entry_size();
+
+                            if(_f.get_tag(e)!=TiffWalker::TagPhotoshop)
+                                continue;
+
+                            uint64_t t = TiffWalker::get_type_size(_f.get_type(e));
+                            uint64_t n = _f.get_value_count(e);
+
+                            // Counts beyond the file can only fail, as long as they don't overflow
+
+                            uint64_t s = n>_size ? _size+1 : t*n;
+
+                            _ps_off = s<=_f.get_word_size() ? _dir+_f.get_count_size()+i*_f.get_entry_size()+_f.get_value_pos()
+                                                             : _f.get_word(e+_f.get_value_pos());
+                            _ps_len = s;
+                        }
+
+                        if(_ps_len==0) {
+                            _page++;
+                            enter(_next);
+                        } else {
+                            _state = Payload;
+                        }
+                        continue;
+
+                    case Payload:
+                        // No read ahead; a buffer holding just the payload can be passed on as is
+
+                        if((p = have(_ps_off,_ps_len,0,ParseStatus::TruncatedData))==NULL)
+                            break;
+
+                        {
+                            BatchScanner::Item_t i;
+
+                            i.file = _index;
+                            i.page = _page;
+                            i.path = _path;
+
+                            if(_buf_off==_ps_off && _buf.size()==_ps_len)
+                                i.data.swap(_buf);
+                            else
+                                i.data.assign(p,p+_ps_len);
+
+                            c.payloads++;
+                            q.push(std::move(i));
+                        }
+
+                        _page++;
+                        enter(_next);
+                        continue;
+
+                    case Done:
+                        break;
+                    }
+
+                    break;
+                }
+
+                if(_state==Done)
+                    return false;
+
+                c.requests++;
+                c.bytes += _req_len;
+
+                return true;
+            }
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+
+            /** Bare bones io_uring: one submission and one completion
+                ring, nothing but IORING_OP_READV.
+             */
+
+            class Ring_t {
+            public:
+                Ring_t(unsigned depth) : _fd(-1),_sq_ptr(MAP_FAILED),_cq_ptr(MAP_FAILED),_sqes(MAP_FAILED),_pending(0) {
+                    struct io_uring_params p;
+
+                    ::memset(&p,0,sizeof(p));
+
+                    if((_fd = ::syscall(__NR_io_uring_setup,depth,&p))<0)
+                        return;
+
+                    _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                    _cq_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+
+                    if(p.features & IORING_FEAT_SINGLE_MMAP)
+                        _sq_size = _cq_size = std::max(_sq_size,_cq_size);
+
+                    _sq_ptr = ::mmap(NULL,_sq_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,_fd,IORING_OFF_SQ_RING);
+
+                    if(_sq_ptr==MAP_FAILED) {
+                        close();
+                        return;
+                    }
+
+                    if(p.features & IORING_FEAT_SINGLE_MMAP)
+                        _cq_ptr = _sq_ptr;
+                    else if((_cq_ptr = ::mmap(NULL,_cq_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,_fd,IORING_OFF_CQ_RING))==MAP_FAILED) {
+                        close();
+                        return;
+                    }
+
+                    _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+                    if((_sqes = ::mmap(NULL,_sqes_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,_fd,IORING_OFF_SQES))==MAP_FAILED) {
+                        close();
+                        return;
+                    }
+
+                    Byte_t * sq = (Byte_t *)_sq_ptr;
+                    Byte_t * cq = (Byte_t *)_cq_ptr;
+
+                    _sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+                    _sq_mask  = *(unsigned *)(sq + p.sq_off.ring_mask);
+                    _sq_array = (unsigned *)(sq + p.sq_off.array);
+                    _cq_head  = (unsigned *)(cq + p.cq_off.head);
+                    _cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+                    _cq_mask  = *(unsigned *)(cq + p.cq_off.ring_mask);
+                    _cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+                }
+
+                Ring_t(const Ring_t &) = delete;
+                Ring_t & operator=(const Ring_t &) = delete;
+
+                ~Ring_t() {
+                    close();
+                }
+
+                bool is_open() const {
+                    return _fd>=0;
+                }
+
+                /** Queue a read; the caller keeps at most as many of
+                    them in flight as the ring was set up for.
+                 */
+
+                void read(int fd,struct iovec * v,uint64_t off,void * data) {
+                    unsigned              t = *_sq_tail;
+                    unsigned              i = t & _sq_mask;
+                    struct io_uring_sqe * e = (struct io_uring_sqe *)_sqes + i;
+
+                    ::memset(e,0,sizeof(*e));
+
+                    e->opcode    = IORING_OP_READV;
+                    e->fd        = fd;
+                    e->addr      = (uint64_t)(uintptr_t)v;
+                    e->len       = 1;
+                    e->off       = off;
+                    e->user_data = (uint64_t)(uintptr_t)data;
+
+                    _sq_array[i] = i;
+                    __atomic_store_n(_sq_tail,t+1,__ATOMIC_RELEASE);
+                    _pending++;
+                }
+
+                /** Submit what's queued and wait for at least one
+                    completion, then call f(data,res) for all of them.
+                    The kernel may take fewer entries than offered;
+                    what it leaves gets offered again, here or by the
+                    next call if it took none.
+                 */
+
+                template<class F>
+                void wait(F f) {
+                    while(true) {
+                        long r = ::syscall(__NR_io_uring_enter,_fd,_pending,1,IORING_ENTER_GETEVENTS,NULL,0);
+
+                        if(r<0) {
+                            if(errno!=EINTR && errno!=EAGAIN && errno!=EBUSY)
+                                throw std::runtime_error(std::string("io_uring_enter: ")+::strerror(errno));
+                            continue;
+                        }
+
+                        _pending -= r;
+
+                        if(_pending==0 || r==0)
+                            break;
+                    }
+
+                    unsigned h = *_cq_head;
+                    unsigned t = __atomic_load_n(_cq_tail,__ATOMIC_ACQUIRE);
+
+                    for(;h!=t;h++) {
+                        const struct io_uring_cqe & e = _cqes[h & _cq_mask];
+                        f((void *)(uintptr_t)e.user_data,e.res);
+                    }
+
+                    __atomic_store_n(_cq_head,h,__ATOMIC_RELEASE);
+                }
+
+            private:
+                void close() {
+                    if(_sqes!=MAP_FAILED)
+                        ::munmap(_sqes,_sqes_size);
+                    if(_cq_ptr!=MAP_FAILED && _cq_ptr!=_sq_ptr)
+                        ::munmap(_cq_ptr,_cq_size);
+                    if(_sq_ptr!=MAP_FAILED)
+                        ::munmap(_sq_ptr,_sq_size);
+                    if(_fd>=0)
+                        ::close(_fd);
+
+                    _fd     = -1;
+                    _sq_ptr = _cq_ptr = _sqes = MAP_FAILED;
+                }
+
+                int                   _fd;
+                void                * _sq_ptr;
+                void                * _cq_ptr;
+                void                * _sqes;
+                size_t                _sq_size;
+                size_t                _cq_size;
+                size_t                _sqes_size;
+                unsigned            * _sq_tail;
+                unsigned              _sq_mask;
+                unsigned            * _sq_array;
+                unsigned            * _cq_head;
+                unsigned            * _cq_tail;
+                unsigned              _cq_mask;
+                struct io_uring_cqe * _cqes;
+                unsigned              _pending;
+            };
+
+            /** Returns false if there is no ring to be had. The ring
+                goes before the jobs whose buffers it may still write to.
+             */
+
+            bool ScanUring(unsigned depth,const std::vector<std::string> & paths,size_t ahead,Queue_t & q,Counters_t & c) {
+                std::vector<Job_t> jobs(std::min<size_t>(std::max(depth,1u),paths.size()));
+                Ring_t             ring(jobs.size());
+                size_t             next     = 0;
+                size_t             inflight = 0;
+
+                if(!ring.is_open())
+                    return false;
+
+                // Run j until it waits for a read, moving on to the next file when it's done
+
+                auto run = [&](Job_t & j) {
+                    while(true) {
+                        if(j.step(ahead,q,c)) {
+                            ring.read(j.get_fd(),j.get_iovec(),j.get_offset(),&j);
+                            inflight++;
+                            return;
+                        }
+
+                        j.finish(q,c);
+
+                        if(next>=paths.size())
+                            return;
+
+                        j.start(next,paths[next]);
+                        next++;
+                    }
+                };
+
+                // A job whose file can't be opened takes the next one right away
+
+                for(size_t i=0;i<jobs.size() && next<paths.size();i++) {
+                    jobs[i].start(next,paths[next]);
+                    next++;
+                    run(jobs[i]);
+                }
+
+                while(inflight>0) {
+                    ring.wait([&](void * d,int r) {
+                        Job_t & j = *(Job_t *)d;
+
+                        inflight--;
+                        j.complete(r);
+                        run(j);
+                    });
+                }
+
+                return true;
+            }
+#else
+            class Ring_t {
+            public:
+                Ring_t(unsigned) {
+                }
+
+                bool is_open() const {
+                    return false;
+                }
+            };
+
+            bool ScanUring(unsigned,const std::vector<std::string> &,size_t,Queue_t &,Counters_t &) {
+                return false;
+            }
+#endif
+
+            void ScanThreads(unsigned n,const std::vector<std::string> & paths,size_t ahead,Queue_t & q,Counters_t & c) {
+                std::atomic<size_t>      next(0);
+                std::vector<std::thread> t;
+
+                for(unsigned i=0;i<std::max(n,1u);i++) {
+                    t.emplace_back([&] {
+                        Job_t j;
+                        size_t k;
+
+                        while((k = next++)<paths.size()) {
+                            j.start(k,paths[k]);
+
+                            while(j.step(ahead,q,c)) {
+                                struct iovec * v = j.get_iovec();
+                                size_t         l = 0;
+                                ssize_t        r = 0;
+
+                                while(l<v->iov_len) {
+                                    r = ::pread(j.get_fd(),(Byte_t *)v->iov_base+l,v->iov_len-l,j.get_offset()+l);
+
+                                    if(r<0 && errno==EINTR)
+                                        continue;
+
+                                    if(r<=0)
+                                        break;
+
+                                    l += r;
+                                }
+
+                                j.complete(r<0 ? -errno : (ssize_t)l);
+                            }
+
+                            j.finish(q,c);
+                        }
+                    });
+                }
+
+                for(std::thread & i : t)
+                    i.join();
+            }
+        }
+
+        BatchScanner::Options_t::Options_t() : backend(Auto),depth(256),io_threads(32),workers(std::thread::hardware_concurrency()),
+                                               read_size(16*1024),queue_size(1024) {
+            if(workers==0)
+                workers = 4;
+        }
+
+        bool BatchScanner::has_uring() {
+            static const bool b = Ring_t(1).is_open();
+            return b;
+        }
+
+        const BatchScanner::Stats_t & BatchScanner::scan(const std::vector<std::string> & paths,Callback_t f) {
+            Counters_t c;
+
+            {
+                Workers_t w(_o.workers,_o.queue_size,f);
+
+                _uring = false;
+
+                if(_o.backend!=Threads && !paths.empty()) {
+                    _uring = ScanUring(_o.depth,paths,_o.read_size,w.get_queue(),c);
+
+                    if(!_uring && _o.backend==Uring)
+                        throw std::runtime_error("io_uring not available");
+                }
+
+                if(!_uring)
+                    ScanThreads(_o.io_threads,paths,_o.read_size,w.get_queue(),c);
+            }
+
+            _stats.files    = c.files;
+            _stats.failed   = c.failed;
+            _stats.requests = c.requests;
+            _stats.bytes    = c.bytes;
+            _stats.payloads = c.payloads;
+
+            return _stats;
+        }
+    }
+}
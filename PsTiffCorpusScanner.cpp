@@ -0,0 +1,367 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/corpus_scanner.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        namespace
+        {
+            typedef std::function<bool(const std::string &)> Emit_t;
+
+            /** A directory being walked, its entries sorted by name
+             */
+
+            struct Frame_t {
+                std::string                                       dir;
+                std::vector<std::pair<std::string,unsigned char>> entries;
+                size_t                                            next;
+            };
+
+            bool ReadDir(const std::string & dir,Frame_t & f) {
+                DIR * d = ::opendir(dir.c_str());
+
+                if(d==NULL)
+                    return false;
+
+                f.dir  = dir;
+                f.next = 0;
+                f.entries.clear();
+
+                if(f.dir.empty() || f.dir.back()!='/')
+                    f.dir += '/';
+
+                for(struct dirent * e;(e = ::readdir(d))!=NULL;) {
+                    if(::strcmp(e->d_name,".")!=0 && ::strcmp(e->d_name,"..")!=0)
+                        f.entries.push_back(std::make_pair(std::string(e->d_name),e->d_type));
+                }
+
+                ::closedir(d);
+
+                std::sort(f.entries.begin(),f.entries.end());
+
+                return true;
+            }
+
+            /** Hand path, or all files below it, to emit until it
+                returns false
+             */
+
+            bool Walk(const std::string & path,const Emit_t & emit) {
+                struct stat          st;
+                std::vector<Frame_t> stack(1);
+
+                if(::stat(path.c_str(),&st)!=0 || !S_ISDIR(st.st_mode) || !ReadDir(path,stack.back()))
+                    return emit(path);
+
+                while(!stack.empty()) {
+                    Frame_t & f = stack.back();
+
+                    if(f.next==f.entries.size()) {
+                        stack.pop_back();
+                        continue;
+                    }
+
+                    const std::pair<std::string,unsigned char> & e = f.entries[f.next++];
+                    std::string                                  p = f.dir+e.first;
+                    unsigned char                                t = e.second;
+
+                    // Some file systems leave the type to a stat() of our own
+
+                    if(t==DT_UNKNOWN) {
+                        if(::lstat(p.c_str(),&st)!=0)
+                            t = DT_REG;
+                        else if(S_ISDIR(st.st_mode))
+                            t = DT_DIR;
+                        else if(S_ISLNK(st.st_mode))
+                            t = DT_LNK;
+                        else if(S_ISREG(st.st_mode))
+                            t = DT_REG;
+                    }
+
+                    // Links to directories could make a loop
+
+                    if(t==DT_LNK && ::stat(p.c_str(),&st)==0)
+                        t = S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+
+                    if(t==DT_DIR) {
+                        Frame_t d;
+
+                        if(ReadDir(p,d))
+                            stack.push_back(std::move(d));
+                        else if(!emit(p))
+                            return false;
+                    } else if(t==DT_REG || t==DT_LNK) {
+                        // A dangling link gets reported by whoever opens it
+
+                        if(!emit(p))
+                            return false;
+                    }
+                }
+
+                return true;
+            }
+
+            struct Deque_t {
+                std::mutex         m;
+                std::deque<size_t> q;
+            };
+        }
+
+        CorpusScanner::Options_t::Options_t() : workers(std::thread::hardware_concurrency()),window(4096) {
+            if(workers==0)
+                workers = 4;
+        }
+
+        size_t CorpusScanner::scan(const Callback_t & f,const Callback_t & g) {
+            const size_t   window  = _o.window;
+            const unsigned workers = _o.workers;
+
+            std::mutex               m;
+            std::condition_variable  work;
+            std::condition_variable  done;
+            std::condition_variable  room;
+            std::vector<std::string> paths(window);
+            std::vector<bool>        ready(window,false);
+            std::vector<Deque_t>     deques(workers);
+            std::atomic<size_t>      queued(0);
+            size_t                   found  = 0;
+            size_t                   handed = 0;
+            bool                     walked = false;
+            bool                     stop   = false;
+            std::exception_ptr       ex;
+
+            auto fail = [&] {
+                {
+                    std::lock_guard<std::mutex> l(m);
+
+                    stop = true;
+
+                    if(!ex)
+                        ex = std::current_exception();
+                }
+
+                work.notify_all();
+                done.notify_all();
+                room.notify_all();
+            };
+
+            // Files get their index in input order once there's room
+            // for them in the window
+
+            Emit_t emit = [&](const std::string & path) {
+                size_t i;
+
+                {
+                    std::unique_lock<std::mutex> l(m);
+
+                    room.wait(l,[&] {
+                        return stop || found-handed<window;
+                    });
+
+                    if(stop)
+                        return false;
+
+                    i = found++;
+                    paths[i%window] = path;
+                }
+
+                {
+                    std::lock_guard<std::mutex> l(deques[i%workers].m);
+                    deques[i%workers].q.push_back(i);
+                }
+
+                {
+                    std::lock_guard<std::mutex> l(m);
+                    queued++;
+                }
+
+                work.notify_one();
+
+                return true;
+            };
+
+            std::thread walker([&] {
+                try {
+                    for(const Input_t & in : _inputs) {
+                        if(!in.list) {
+                            if(!Walk(in.path,emit))
+                                break;
+                            continue;
+                        }
+
+                        std::ifstream file;
+
+                        if(in.path!="-") {
+                            file.open(in.path);
+
+                            if(!file)
+                                throw std::runtime_error("CorpusScanner: can't read list '"+in.path+"'");
+                        }
+
+                        std::istream & s = in.path=="-" ? std::cin : file;
+                        std::string    p;
+                        bool           more = true;
+
+                        while(more && std::getline(s,p)) {
+                            if(!p.empty() && p.back()=='\r')
+                                p.pop_back();
+
+                            if(!p.empty())
+                                more = Walk(p,emit);
+                        }
+
+                        if(!more)
+                            break;
+                    }
+                } catch(...) {
+                    fail();
+                }
+
+                {
+                    std::lock_guard<std::mutex> l(m);
+                    walked = true;
+                }
+
+                work.notify_all();
+                done.notify_all();
+            });
+
+            // Own deque from the front, the others from the back
+
+            auto take = [&](unsigned w,size_t & i) {
+                for(unsigned k=0;k<workers;k++) {
+                    Deque_t &                   d = deques[(w+k)%workers];
+                    std::lock_guard<std::mutex> l(d.m);
+
+                    if(d.q.empty())
+                        continue;
+
+                    if(k==0) {
+                        i = d.q.front();
+                        d.q.pop_front();
+                    } else {
+                        i = d.q.back();
+                        d.q.pop_back();
+                    }
+
+                    queued--;
+
+                    return true;
+                }
+
+                return false;
+            };
+
+            std::vector<std::thread> threads;
+
+            for(unsigned w=0;w<workers;w++) {
+                threads.emplace_back([&,w] {
+                    try {
+                        while(true) {
+                            size_t i;
+
+                            if(!take(w,i)) {
+                                std::unique_lock<std::mutex> l(m);
+
+                                work.wait(l,[&] {
+                                    return stop || walked || queued>0;
+                                });
+
+                                if(stop || (walked && queued==0))
+                                    return;
+
+                                continue;
+                            }
+
+                            f(i,paths[i%window]);
+
+                            {
+                                std::lock_guard<std::mutex> l(m);
+                                ready[i%window] = true;
+                            }
+
+                            done.notify_one();
+                        }
+                    } catch(...) {
+                        fail();
+                    }
+                });
+            }
+
+            // Hand the files on in order, making room for the walk
+
+            try {
+                for(size_t i=0;;i++) {
+                    {
+                        std::unique_lock<std::mutex> l(m);
+
+                        done.wait(l,[&] {
+                            return stop || ready[i%window] || (walked && i==found);
+                        });
+
+                        if(stop || !ready[i%window])
+                            break;
+                    }
+
+                    g(i,paths[i%window]);
+
+                    {
+                        std::lock_guard<std::mutex> l(m);
+
+                        ready[i%window] = false;
+                        handed++;
+                    }
+
+                    room.notify_one();
+                }
+            } catch(...) {
+                fail();
+            }
+
+            walker.join();
+
+            for(std::thread & t : threads)
+                t.join();
+
+            if(ex)
+                std::rethrow_exception(ex);
+
+            return found;
+        }
+    }
+}
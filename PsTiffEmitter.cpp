@@ -0,0 +1,404 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/emitter.h>
+#include <pstiff/tools/strings.h>
+
+#include <stdexcept>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        namespace
+        {
+            const char Hex[] = "0123456789abcdef";
+
+            /** Decimal digits of v written to p; returns the first byte
+                behind them. p needs room for 20.
+             */
+
+            char * PutDecimal(char * p,uint64_t v) {
+                char   d[20];
+                size_t n = 0;
+
+                do {
+                    d[n++] = '0' + v % 10;
+                    v /= 10;
+                } while(v!=0);
+
+                while(n>0)
+                    *p++ = d[--n];
+
+                return p;
+            }
+
+            size_t Utf8Size(uint32_t c) {
+                return c<0x80 ? 1 : c<0x800 ? 2 : c<0x10000 ? 3 : 4;
+            }
+
+            /** c as JSON escape sequence or plain; p needs room for 6
+             */
+
+            char * PutEscaped(char * p,unsigned char c) {
+                switch(c) {
+                case '"':  *p++ = '\\'; *p++ = '"';  return p;
+                case '\\': *p++ = '\\'; *p++ = '\\'; return p;
+                case '\n': *p++ = '\\'; *p++ = 'n';  return p;
+                case '\r': *p++ = '\\'; *p++ = 'r';  return p;
+                case '\t': *p++ = '\\'; *p++ = 't';  return p;
+                }
+
+                if(c<0x20) {
+                    *p++ = '\\';
+                    *p++ = 'u';
+                    *p++ = '0';
+                    *p++ = '0';
+                    *p++ = Hex[c>>4];
+                    *p++ = Hex[c & 0xf];
+                    return p;
+                }
+
+                *p++ = c;
+                return p;
+            }
+        }
+
+        std::unique_ptr<Emitter> Emitter::create(Format_t f) {
+            switch(f) {
+            case Ndjson:
+                return std::unique_ptr<Emitter>(new NdjsonEmitter());
+            case Binary:
+                return std::unique_ptr<Emitter>(new BinaryEmitter());
+            }
+
+            throw std::runtime_error("Emitter: unknown format");
+        }
+
+        void NdjsonEmitter::separate() {
+            if(_key) {
+                _key = false;
+                return;
+            }
+
+            if(!_first[_depth])
+                put(',');
+
+            _first[_depth] = false;
+        }
+
+        void NdjsonEmitter::open(char c) {
+            if(_depth+1>=MaxDepth)
+                throw std::runtime_error("NdjsonEmitter: nested too deep");
+
+            separate();
+            put(c);
+
+            _first[++_depth] = true;
+        }
+
+        void NdjsonEmitter::close(char c) {
+            if(_depth==0)
+                throw std::runtime_error("NdjsonEmitter: nothing to close");
+
+            put(c);
+            _depth--;
+        }
+
+        template<class S,class F>
+        void NdjsonEmitter::quote(S s,F f) {
+
+            // Escapes take 6 bytes, UTF-8 no more than 4 per character
+
+            char * p = reserve(s.length()*6+2);
+
+            *p++ = '"';
+
+            for(size_t i=0;i<s.length();) {
+                uint32_t c = f(s,i);
+
+                p = c<0x80 ? PutEscaped(p,c) : Tools::put_utf8(p,c);
+            }
+
+            *p++ = '"';
+
+            commit(p);
+        }
+
+        void NdjsonEmitter::quote(std::string_view s) {
+            quote(s,Tools::next_utf8);
+        }
+
+        Emitter & NdjsonEmitter::begin_record() {
+            _depth    = 0;
+            _key      = false;
+            _first[0] = true;
+
+            return begin_object();
+        }
+
+        Emitter & NdjsonEmitter::end_record() {
+            end_object();
+            put('\n');
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::begin_object() {
+            open('{');
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::end_object() {
+            close('}');
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::begin_array() {
+            open('[');
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::end_array() {
+            close(']');
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::key(std::string_view k) {
+            separate();
+            quote(k);
+            put(':');
+
+            _key = true;
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::uint(uint64_t v) {
+            separate();
+            commit(PutDecimal(reserve(20),v));
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::sint(int64_t v) {
+            separate();
+
+            char * p = reserve(21);
+
+            if(v<0) {
+                *p++ = '-';
+                p = PutDecimal(p,0-(uint64_t)v);
+            } else {
+                p = PutDecimal(p,v);
+            }
+
+            commit(p);
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::boolean(bool v) {
+            separate();
+
+            if(v)
+                put("true",4);
+            else
+                put("false",5);
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::string(std::string_view s) {
+            separate();
+            quote(s);
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::mac_string(std::string_view s) {
+            separate();
+            quote(s,[](std::string_view s,size_t & i) { return Tools::from_mac_roman(s[i++]); });
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::string(std::wstring_view s) {
+            separate();
+            quote(s,Tools::next_code_point);
+
+            return *this;
+        }
+
+        Emitter & NdjsonEmitter::bytes(const Byte_t * b,size_t n) {
+            separate();
+
+            char * p = reserve(n*2+2);
+
+            *p++ = '"';
+
+            for(size_t i=0;i<n;i++) {
+                *p++ = Hex[b[i]>>4];
+                *p++ = Hex[b[i] & 0xf];
+            }
+
+            *p++ = '"';
+
+            commit(p);
+
+            return *this;
+        }
+
+        void BinaryEmitter::varint(uint64_t v) {
+            char * p = reserve(10);
+
+            for(;v>=0x80;v>>=7)
+                *p++ = (char)(0x80 | (v & 0x7f));
+
+            *p++ = (char)v;
+
+            commit(p);
+        }
+
+        void BinaryEmitter::tagged(Tag_t t,const char * p,size_t n) {
+            put(t);
+            varint(n);
+            put(p,n);
+        }
+
+        Emitter & BinaryEmitter::begin_record() {
+            _record = size();
+
+            commit(reserve(4)+4);
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::end_record() {
+            from32((Byte_t *)_buf.data()+_record,size()-_record-4);
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::begin_object() {
+            put(ObjectBegin);
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::end_object() {
+            put(ObjectEnd);
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::begin_array() {
+            put(ArrayBegin);
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::end_array() {
+            put(ArrayEnd);
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::key(std::string_view k) {
+            tagged(Key,k.data(),k.length());
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::uint(uint64_t v) {
+            put(UInt);
+            varint(v);
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::sint(int64_t v) {
+            put(SInt);
+            varint(((uint64_t)v<<1) ^ (uint64_t)(v>>63));
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::boolean(bool v) {
+            put(v ? True : False);
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::string(std::string_view s) {
+            size_t n = 0;
+
+            // Each byte replaced by U+FFFD grows by 2
+
+            for(size_t i=0;i<s.length();)
+                n += Utf8Size(Tools::next_utf8(s,i));
+
+            if(n==s.length()) {
+                tagged(String,s.data(),s.length());
+                return *this;
+            }
+
+            put(String);
+            varint(n);
+
+            char * p = reserve(n);
+
+            for(size_t i=0;i<s.length();)
+                p = Tools::put_utf8(p,Tools::next_utf8(s,i));
+
+            commit(p);
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::mac_string(std::string_view s) {
+            size_t n = 0;
+
+            for(unsigned char c : s)
+                n += Utf8Size(Tools::from_mac_roman(c));
+
+            put(String);
+            varint(n);
+
+            char * p = reserve(n);
+
+            for(unsigned char c : s)
+                p = Tools::put_utf8(p,Tools::from_mac_roman(c));
+
+            commit(p);
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::string(std::wstring_view s) {
+            size_t n = Tools::utf8_size(s);
+
+            put(String);
+            varint(n);
+            commit(Tools::put_utf8(reserve(n),s));
+
+            return *this;
+        }
+
+        Emitter & BinaryEmitter::bytes(const Byte_t * p,size_t n) {
+            tagged(Bytes,(const char *)p,n);
+            return *this;
+        }
+    }
+}
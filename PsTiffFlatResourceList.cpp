@@ -0,0 +1,149 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/FlatResourceList.h>
+
+#include <stdexcept>
+
+#include <string.h>
+
+namespace PsTiff
+{
+    namespace
+    {
+        template<class R>
+        bool Is(const ResourceDecoder & d,ResourceId::Enum_t e) {
+            return d.get(e)==&ResourceDecoder::Decode<R>;
+        }
+
+        /** Whether entry_t has an alternative for what d makes of e
+         */
+
+        bool Fits(const ResourceDecoder & d,ResourceId::Enum_t e) {
+            switch(e) {
+            case ResourceId::AlternateSpotColors:
+                return Is<SpotColorResource>(d,e);
+            case ResourceId::AlphaNames:
+                return Is<AlphaNamesResource>(d,e);
+            case ResourceId::UnicodeAlphaNames:
+                return Is<UnicodeAlphaNamesResource>(d,e);
+            case ResourceId::AlphaIdentifiers:
+                return Is<AlphaIdentifiersResource>(d,e);
+            case ResourceId::IdSeedNumber:
+                return Is<IdSeedNumberResource>(d,e);
+            case ResourceId::VersionInfo:
+                return Is<VersionInfoResource>(d,e);
+            case ResourceId::DisplayInfo:
+                return Is<DisplayInfoResource>(d,e);
+            default:
+                return false;
+            }
+        }
+    }
+
+    void FlatResourceList::check(const ResourceDecoder & d) {
+        for(int i=0;i<ResourceId::EnumCount;i++) {
+            ResourceId::Enum_t e = (ResourceId::Enum_t)i;
+
+            if(d.is_selected(e) && d.has(e) && !Fits(d,e))
+                throw std::runtime_error(std::string("FlatResourceList: can't hold what the decoder for ")+
+                                         ResourceId::to_name(e)+" makes");
+        }
+    }
+
+    void FlatResourceList::add(const ResourceView & v,const ResourceDecoder & d) {
+        ResourceId::Enum_t e  = v.get_id().to_enum();
+        Memory_t         * mr = get_memory_resource();
+
+        if(!d.has(e)) {
+            _v.emplace_back(std::in_place_type<Resource>,v,mr);
+            return;
+        }
+
+        switch(e) {
+        case ResourceId::AlternateSpotColors:
+            _v.emplace_back(std::in_place_type<SpotColorResource>,v,mr);
+            break;
+        case ResourceId::AlphaNames:
+            _v.emplace_back(std::in_place_type<AlphaNamesResource>,v,mr);
+            break;
+        case ResourceId::UnicodeAlphaNames:
+            _v.emplace_back(std::in_place_type<UnicodeAlphaNamesResource>,v,mr);
+            break;
+        case ResourceId::AlphaIdentifiers:
+            _v.emplace_back(std::in_place_type<AlphaIdentifiersResource>,v,mr);
+            break;
+        case ResourceId::IdSeedNumber:
+            _v.emplace_back(std::in_place_type<IdSeedNumberResource>,v,mr);
+            break;
+        case ResourceId::VersionInfo:
+            _v.emplace_back(std::in_place_type<VersionInfoResource>,v,mr);
+            break;
+        case ResourceId::DisplayInfo:
+            _v.emplace_back(std::in_place_type<DisplayInfoResource>,v,mr);
+            break;
+        default:
+            _v.emplace_back(std::in_place_type<Resource>,v,mr);
+            break;
+        }
+    }
+
+    void FlatResourceList::read(const Byte_t * p,size_t n,const ResourceDecoder & d) {
+        try_read(p,n,d).check();
+    }
+
+    void FlatResourceList::read(const Buffer_t & b,size_t n,const ResourceDecoder & d) {
+        try_read(b,n,d).check();
+    }
+
+    ParseStatus FlatResourceList::try_read(const Byte_t * p,size_t n,const ResourceDecoder & d,
+                                           ParsePolicy_t pol,ParseDiagnostics * diag) {
+        Byte_t * c = NULL;
+        Buffer_t b = make_buffer(n,c,get_memory_resource());
+
+        ::memcpy(c,p,n);
+
+        return try_read(b,n,d,pol,diag);
+    }
+
+    ParseStatus FlatResourceList::try_read(const Buffer_t & b,size_t n,const ResourceDecoder & d,
+                                           ParsePolicy_t pol,ParseDiagnostics * diag) {
+        check(d);
+        clear();
+
+        return d.try_select(b.get(),n,[&](const ResourceView & v) {
+            add(v,d);
+            std::visit([&b](auto & r) { r.keep_alive(b); },_v.back());
+        },pol,diag);
+    }
+
+    bool FlatResourceList::read(TIFF * in,const ResourceDecoder & d) {
+        uint32_t n    = 0;
+        void   * data = NULL;
+
+        clear();
+
+        if(in==NULL || TIFFGetField(in,TIFFTAG_PHOTOSHOP,&n,&data)!=1 || data==NULL)
+            return false;
+
+        read((const Byte_t *)data,n,d);
+        return true;
+    }
+}
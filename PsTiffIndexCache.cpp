@@ -0,0 +1,399 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/index_cache.h>
+#include <pstiff/ResourceDecoder.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        namespace
+        {
+            const char   Magic[8]   = {'P','S','T','I','N','D','X','1'};
+            const size_t BufferSize = 1024*1024;
+
+            /** Page header within a record: page, offset, size and
+                length of the summary
+             */
+
+            const size_t PageSize = sizeof(uint32_t)+2*sizeof(uint64_t)+sizeof(uint32_t);
+
+            uint32_t Fnv1a(const Byte_t * p,size_t n) {
+                uint32_t h = 2166136261u;
+
+                for(size_t i=0;i<n;i++)
+                    h = (h ^ p[i]) * 16777619u;
+
+                return h;
+            }
+
+            template<class T>
+            T Get(const Byte_t * p) {
+                T v;
+                ::memcpy(&v,p,sizeof(T));
+                return v;
+            }
+
+            template<class T>
+            void Put(std::vector<Byte_t> & b,T v) {
+                const Byte_t * p = (const Byte_t *)&v;
+                b.insert(b.end(),p,p+sizeof(T));
+            }
+        }
+
+        bool IndexCache::open(const std::string & path) {
+            close();
+
+            _path = path;
+
+            if(!_file.open(path))
+                return false;
+
+            const Byte_t   * p = _file.data();
+            size_t           n = _file.size();
+            const Header_t * h = (const Header_t *)p;
+
+            if(n<sizeof(Header_t) || ::memcmp(h->magic,Magic,sizeof(Magic))!=0 || h->order!=ByteOrder ||
+               h->entry_size!=sizeof(Entry_t) || h->table%8!=0 || h->table>n || h->count>(n-h->table)/sizeof(Entry_t)) {
+                _file.close();
+                return false;
+            }
+
+            // Lookups need the entries in order, one per file
+
+            const Entry_t * t = (const Entry_t *)(p+h->table);
+
+            for(uint64_t i=1;i<h->count;i++) {
+                if(!less(t[i-1],t[i])) {
+                    _file.close();
+                    return false;
+                }
+            }
+
+            _h = h;
+
+            return true;
+        }
+
+        void IndexCache::close() {
+            if(_fd>=0) {
+                ::close(_fd);
+                ::unlink(_tmp.c_str());
+            }
+
+            _file.close();
+            _h       = NULL;
+            _fd      = -1;
+            _written = 0;
+            _buf.clear();
+            _added.clear();
+            _keys.clear();
+            _kept.clear();
+        }
+
+        size_t IndexCache::size() const {
+            return _h==NULL ? 0 : _h->count;
+        }
+
+        const IndexCache::Entry_t * IndexCache::get_table() const {
+            return (const Entry_t *)(_file.data()+_h->table);
+        }
+
+        const Byte_t * IndexCache::get_record(const Entry_t & e) const {
+            if(e.type>Jpeg || e.offset<sizeof(Header_t) || e.offset>_h->table || e.length>_h->table-e.offset)
+                return NULL;
+
+            const Byte_t * p = _file.data()+e.offset;
+
+            return Fnv1a(p,e.length)==e.check ? p : NULL;
+        }
+
+        bool IndexCache::get_key(const std::string & path,Key_t & k) {
+            struct stat st;
+
+            if(::stat(path.c_str(),&st)!=0)
+                return false;
+
+            k.dev   = st.st_dev;
+            k.ino   = st.st_ino;
+            k.size  = st.st_size;
+            k.mtime = (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+
+            return true;
+        }
+
+        bool IndexCache::find(const Key_t & k,Record_t & r) const {
+            if(_h==NULL)
+                return false;
+
+            Entry_t         key;
+            const Entry_t * b = get_table();
+            const Entry_t * e = b+_h->count;
+
+            key.dev = k.dev;
+            key.ino = k.ino;
+
+            const Entry_t * i = std::lower_bound(b,e,key,less);
+
+            if(i==e || i->dev!=k.dev || i->ino!=k.ino || i->size!=k.size || i->mtime!=k.mtime)
+                return false;
+
+            const Byte_t * p = get_record(*i);
+            size_t         n = i->length;
+
+            if(p==NULL || n<sizeof(uint32_t))
+                return false;
+
+            uint32_t c = Get<uint32_t>(p);
+            size_t   o = sizeof(uint32_t);
+
+            r.type = (Type_t)i->type;
+            r.pages.clear();
+
+            for(uint32_t j=0;j<c;j++) {
+                if(n-o<PageSize)
+                    return false;
+
+                Page_t pg;
+
+                pg.page   = Get<uint32_t>(p+o);
+                pg.offset = Get<uint64_t>(p+o+4);
+                pg.size   = Get<uint64_t>(p+o+12);
+
+                uint32_t l = Get<uint32_t>(p+o+20);
+
+                o += PageSize;
+
+                if(n-o<l)
+                    return false;
+
+                pg.summary = Span_t(p+o,l);
+                o += l;
+
+                r.pages.push_back(pg);
+            }
+
+            return true;
+        }
+
+        void IndexCache::write(const void * p,size_t n) {
+            _buf.insert(_buf.end(),(const Byte_t *)p,(const Byte_t *)p+n);
+            _written += n;
+
+            if(_buf.size()>=BufferSize)
+                flush();
+        }
+
+        void IndexCache::flush() {
+            uint64_t off = _written-_buf.size();
+
+            for(size_t l=0;l<_buf.size();) {
+                ssize_t r = ::pwrite(_fd,_buf.data()+l,_buf.size()-l,off+l);
+
+                if(r<0 && errno==EINTR)
+                    continue;
+
+                if(r<0)
+                    throw std::runtime_error(std::string("IndexCache: write failed: ")+::strerror(errno));
+
+                l += r;
+            }
+
+            _buf.clear();
+        }
+
+        void IndexCache::create() {
+            if(_fd>=0)
+                return;
+
+            _tmp = _path+".tmp."+std::to_string(::getpid());
+
+            if((_fd = ::open(_tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644))<0)
+                throw std::runtime_error("IndexCache: can't create '"+_tmp+"': "+::strerror(errno));
+
+            // The header goes in last
+
+            _written = sizeof(Header_t);
+        }
+
+        void IndexCache::keep(const Key_t & k) {
+            _kept.insert(std::make_tuple(k.dev,k.ino,k.size,k.mtime));
+        }
+
+        void IndexCache::add(const Key_t & k,const Record_t & r) {
+            if(_path.empty())
+                throw std::runtime_error("IndexCache: no index opened");
+
+            if(!_keys.insert(std::make_pair(k.dev,k.ino)).second)
+                return;
+
+            create();
+
+            std::vector<Byte_t> b;
+
+            Put<uint32_t>(b,r.pages.size());
+
+            for(const Page_t & p : r.pages) {
+                Put<uint32_t>(b,p.page);
+                Put<uint64_t>(b,p.offset);
+                Put<uint64_t>(b,p.size);
+                Put<uint32_t>(b,p.summary.size());
+                b.insert(b.end(),p.summary.data(),p.summary.data()+p.summary.size());
+            }
+
+            Entry_t e;
+
+            ::memset(&e,0,sizeof(e));
+
+            e.dev    = k.dev;
+            e.ino    = k.ino;
+            e.size   = k.size;
+            e.mtime  = k.mtime;
+            e.offset = _written;
+            e.length = b.size();
+            e.type   = r.type;
+            e.check  = Fnv1a(b.data(),b.size());
+
+            write(b.data(),b.size());
+
+            _added.push_back(e);
+        }
+
+        void IndexCache::commit(bool prune) {
+            const Entry_t * o  = _h==NULL ? NULL : get_table();
+            const Entry_t * oe = _h==NULL ? NULL : o+_h->count;
+
+            auto kept = [&](const Entry_t & e) {
+                return !prune || _kept.count(std::make_tuple(e.dev,e.ino,e.size,e.mtime))!=0;
+            };
+
+            if(_added.empty() && std::all_of(o,oe,kept)) {
+                _kept.clear();
+                return;
+            }
+
+            create();
+
+            std::sort(_added.begin(),_added.end(),less);
+
+            std::vector<Entry_t> all;
+
+            all.reserve(_added.size()+size());
+
+            // Old records move over unless damaged or pruned
+
+            auto keep = [&](const Entry_t & old) {
+                const Byte_t * p = get_record(old);
+
+                if(p==NULL || !kept(old))
+                    return;
+
+                Entry_t e = old;
+
+                e.offset = _written;
+                write(p,old.length);
+                all.push_back(e);
+            };
+
+            // The ones added replace the old ones
+
+            for(size_t i=0;i<_added.size();i++) {
+                for(;o!=oe && less(*o,_added[i]);o++)
+                    keep(*o);
+
+                if(o!=oe && !less(_added[i],*o))
+                    o++;
+
+                all.push_back(_added[i]);
+            }
+
+            for(;o!=oe;o++)
+                keep(*o);
+
+            static const Byte_t Zero[8] = {0};
+
+            write(Zero,(8-_written%8)%8);
+
+            Header_t h;
+
+            ::memset(&h,0,sizeof(h));
+            ::memcpy(h.magic,Magic,sizeof(Magic));
+
+            h.order      = ByteOrder;
+            h.entry_size = sizeof(Entry_t);
+            h.count      = all.size();
+            h.table      = _written;
+
+            write(all.data(),all.size()*sizeof(Entry_t));
+            flush();
+
+            _buf.assign((const Byte_t *)&h,(const Byte_t *)&h+sizeof(h));
+            _written = sizeof(h);
+            flush();
+
+            ::close(_fd);
+            _fd = -1;
+
+            if(::rename(_tmp.c_str(),_path.c_str())!=0) {
+                int e = errno;
+                ::unlink(_tmp.c_str());
+                throw std::runtime_error("IndexCache: can't replace '"+_path+"': "+::strerror(e));
+            }
+
+            open(std::string(_path));
+        }
+
+        void IndexCache::summarize(const Byte_t * p,size_t n,std::vector<Byte_t> & out) {
+            const ResourceDecoder & dec   = ResourceDecoder::Default();
+            bool                    clean = true;
+
+            ParseStatus s = ResourceBlocks(p,n).for_each([&](const ResourceView & v) {
+                if(dec.has(v.get_id().to_enum()) && !dec.validate(v))
+                    clean = false;
+                return clean;
+            });
+
+            if(!clean || !s) {
+                out.insert(out.end(),p,p+n);
+                return;
+            }
+
+            ResourceBlocks(p,n).for_each([&](const ResourceView & v) {
+                if(dec.has(v.get_id().to_enum())) {
+                    // The padding of the last block may be missing
+
+                    size_t l = std::min<size_t>(v.get_size(),p+n-v.get_raw());
+                    out.insert(out.end(),v.get_raw(),v.get_raw()+l);
+                }
+                return true;
+            });
+        }
+    }
+}
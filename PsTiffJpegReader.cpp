@@ -0,0 +1,221 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/JpegReader.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    namespace
+    {
+        const Byte_t   Signature[]   = "Photoshop 3.0";    // with the trailing 0
+        const size_t   SignatureSize = sizeof(Signature);
+
+        const Byte_t   SOI  = 0xd8;
+        const Byte_t   EOI  = 0xd9;
+        const Byte_t   SOS  = 0xda;
+        const Byte_t   APP13 = 0xed;
+
+        /** Follow the segments of a JPEG of size bytes; have(off,n)
+            hands out the n bytes at off, NULL if there are none.
+         */
+
+        template<class H>
+        ParseStatus Scan(H have,uint64_t size,JpegReader::Parts_t & parts) {
+            const Byte_t * p = have(0,2);
+
+            parts.clear();
+
+            if(p==NULL || p[0]!=0xff || p[1]!=SOI)
+                return ParseStatus(ParseStatus::BadJpegHeader,0);
+
+            for(uint64_t off=2;;) {
+                if((p = have(off,2))==NULL || p[0]!=0xff)
+                    return ParseStatus(ParseStatus::BadSegment,off);
+
+                // Any number of 0xff may pad the space before a marker
+
+                if(p[1]==0xff) {
+                    off++;
+                    continue;
+                }
+
+                Byte_t m = p[1];
+
+                off += 2;
+
+                // Everything from SOS on is image data
+
+                if(m==EOI || m==SOS)
+                    return ParseStatus();
+
+                // TEM, RSTn and SOI come without a length
+
+                if(m==0x01 || (m>=0xd0 && m<=SOI))
+                    continue;
+
+                if((p = have(off,2))==NULL)
+                    return ParseStatus(ParseStatus::BadSegment,off);
+
+                uint64_t l = to16(p);
+
+                if(l<2 || l>size-off)
+                    return ParseStatus(ParseStatus::BadSegment,off);
+
+                if(m==APP13 && l-2>=SignatureSize) {
+                    if((p = have(off+2,SignatureSize))==NULL)
+                        return ParseStatus(ParseStatus::BadSegment,off);
+
+                    if(::memcmp(p,Signature,SignatureSize)==0) {
+                        JpegReader::Part_t r;
+
+                        r.offset = off+2+SignatureSize;
+                        r.size   = l-2-SignatureSize;
+
+                        parts.push_back(r);
+                    }
+                }
+
+                off += l;
+            }
+        }
+    }
+
+    ParseStatus JpegReader::find_resources(const Byte_t * p,size_t n,Parts_t & parts) {
+        if(p==NULL)
+            return ParseStatus(ParseStatus::BadJpegHeader,0);
+
+        return Scan([p,n](uint64_t off,size_t l) -> const Byte_t * {
+            return off<=n && l<=n-off ? p+off : NULL;
+        },n,parts);
+    }
+
+    bool JpegReader::open(const std::string & path) {
+        close();
+
+        if((_fd = ::open(path.c_str(),O_RDONLY|O_CLOEXEC))<0)
+            return false;
+
+        struct stat st;
+
+        if(::fstat(_fd,&st)!=0) {
+            close();
+            return false;
+        }
+
+        _size = st.st_size;
+
+        // The headers of neighbouring segments mostly share a read;
+        // big segments, like an EXIF APP1, get skipped
+
+        static const size_t Window = 4096;
+
+        std::vector<Byte_t> w;
+        uint64_t            w_off = 0;
+
+        _st = Scan([&](uint64_t off,size_t l) -> const Byte_t * {
+            if(off>=w_off && off-w_off<=w.size() && l<=w.size()-(off-w_off))
+                return w.data()+(off-w_off);
+
+            if(off>_size || l>_size-off)
+                return NULL;
+
+            w.resize(std::min<uint64_t>(std::max(l,Window),_size-off));
+            w_off = off;
+
+            return read(off,w.data(),w.size()) ? w.data() : NULL;
+        },_size,_parts);
+
+        return true;
+    }
+
+    void JpegReader::close() {
+        if(_fd>=0)
+            ::close(_fd);
+
+        _fd   = -1;
+        _size = 0;
+        _st   = ParseStatus();
+        _parts.clear();
+    }
+
+    uint64_t JpegReader::get_resources_size() const {
+        uint64_t n = 0;
+
+        for(const Part_t & p : _parts)
+            n += p.size;
+
+        return n;
+    }
+
+    /** Read p[n] at off; false if the file ends before
+     */
+
+    bool JpegReader::read(uint64_t off,void * p,size_t n) {
+        if(off>_size || n>_size-off)
+            return false;
+
+        for(size_t l=0;l<n;) {
+            ssize_t r = ::pread(_fd,(Byte_t *)p+l,n-l,off+l);
+
+            if(r<0 && errno==EINTR)
+                continue;
+
+            if(r<0)
+                throw std::runtime_error(std::string("JpegReader: read failed: ")+::strerror(errno));
+
+            if(r==0)
+                return false;
+
+            l += r;
+        }
+
+        return true;
+    }
+
+    ParseStatus JpegReader::read_resources(Buffer_t & b,Memory_t * mr) {
+        if(!is_open())
+            return ParseStatus(ParseStatus::BadJpegHeader,0);
+
+        if(!_st)
+            return _st;
+
+        Byte_t * p = NULL;
+
+        b = make_buffer(get_resources_size(),p,mr);
+
+        for(const Part_t & r : _parts) {
+            if(!read(r.offset,p,r.size))
+                return ParseStatus(ParseStatus::BadSegment,r.offset);
+
+            p += r.size;
+        }
+
+        return ParseStatus();
+    }
+}
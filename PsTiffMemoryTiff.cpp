@@ -0,0 +1,123 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/memory_tiff.h>
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        MemoryTiff::MemoryTiff(const Byte_t * p,size_t n) : _ro(p),_n(n),_rw(NULL),_pos(0),_tif(NULL) {
+            open("r");
+        }
+
+        MemoryTiff::MemoryTiff(std::vector<Byte_t> & v,const char * mode) : _ro(NULL),_n(0),_rw(&v),_pos(0),_tif(NULL) {
+            if(mode[0]=='w')
+                v.clear();
+            open(mode);
+        }
+
+        void MemoryTiff::open(const char * mode) {
+            _tif = TIFFClientOpen("memory",mode,(thandle_t)this,Read,Write,Seek,Close,Size,Map,Unmap);
+        }
+
+        tmsize_t MemoryTiff::Read(thandle_t h,void * p,tmsize_t n) {
+            MemoryTiff * m = (MemoryTiff *)h;
+            size_t       s = m->get_size();
+
+            if(n<=0 || m->_pos>=s)
+                return 0;
+
+            size_t l = (size_t)n < s - m->_pos ? (size_t)n : s - m->_pos;
+
+            ::memcpy(p,m->get_data() + m->_pos,l);
+            m->_pos += l;
+
+            return (tmsize_t)l;
+        }
+
+        tmsize_t MemoryTiff::Write(thandle_t h,void * p,tmsize_t n) {
+            MemoryTiff * m = (MemoryTiff *)h;
+
+            if(m->_rw==NULL || n<0)
+                return -1;
+
+            std::vector<Byte_t> & v = *m->_rw;
+
+            if(m->_pos + n > v.size()) {
+                // Let the vector grow geometrically, libtiff writes in small pieces
+                if(m->_pos + n > v.capacity())
+                    v.reserve(std::max<size_t>(m->_pos + n,v.capacity() * 2));
+                v.resize(m->_pos + n);
+            }
+
+            ::memcpy(v.data() + m->_pos,p,n);
+            m->_pos += n;
+
+            return n;
+        }
+
+        toff_t MemoryTiff::Seek(thandle_t h,toff_t o,int w) {
+            MemoryTiff * m = (MemoryTiff *)h;
+
+            switch(w) {
+            case SEEK_SET: m->_pos  = o;                 break;
+            case SEEK_CUR: m->_pos += o;                 break;
+            case SEEK_END: m->_pos  = m->get_size() + o; break;
+            default:
+                return (toff_t)-1;
+            }
+
+            return m->_pos;
+        }
+
+        int MemoryTiff::Close(thandle_t) {
+            return 0;
+        }
+
+        toff_t MemoryTiff::Size(thandle_t h) {
+            return ((MemoryTiff *)h)->get_size();
+        }
+
+        /** Only the read only blob can be handed out as mapping; the
+            vector may move while libtiff writes.
+         */
+
+        int MemoryTiff::Map(thandle_t h,void ** p,toff_t * n) {
+            MemoryTiff * m = (MemoryTiff *)h;
+
+            if(m->_rw!=NULL)
+                return 0;
+
+            *p = (void *)m->_ro;
+            *n = m->_n;
+
+            return 1;
+        }
+
+        void MemoryTiff::Unmap(thandle_t,void *,toff_t) {
+        }
+    }
+}
@@ -0,0 +1,166 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/page_processor.h>
+#include <pstiff/io/memory_tiff.h>
+#include <pstiff/TiffWalker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        PageProcessor::Options_t::Options_t() : workers(std::thread::hardware_concurrency()) {
+            if(workers==0)
+                workers = 4;
+        }
+
+        bool PageProcessor::open(const std::string & path) {
+            close();
+
+            if(!_file.open(path))
+                return false;
+
+            _p = _file.data();
+            _n = _file.size();
+            _st = scan();
+
+            return true;
+        }
+
+        bool PageProcessor::open(const Byte_t * p,size_t n) {
+            close();
+
+            if(p==NULL)
+                return false;
+
+            _p = p;
+            _n = n;
+            _st = scan();
+
+            return true;
+        }
+
+        void PageProcessor::close() {
+            _file.close();
+            _p = NULL;
+            _n = 0;
+            _st = ParseStatus();
+            _offsets.clear();
+        }
+
+        ParseStatus PageProcessor::scan() {
+            TiffWalker w(_p,_n);
+
+            return w.for_each([this](const TiffWalker::Directory_t & d) {
+                _offsets.push_back(d.offset);
+                return true;
+            });
+        }
+
+        ParseStatus PageProcessor::run(const Callback_t & f) {
+            return process(f,false);
+        }
+
+        ParseStatus PageProcessor::process(const Callback_t & f,bool failed) {
+            if(!is_open())
+                return ParseStatus(ParseStatus::BadTiffHeader,0);
+
+            size_t pages = get_pages();
+
+            if(pages==0)
+                return _st;
+
+            // All handles get opened up front; a worker without one
+            // would leave its share of the pages undone
+
+            std::vector<std::unique_ptr<MemoryTiff>> h;
+
+            while(h.size()<std::max<size_t>(1,std::min<size_t>(_o.workers,pages))) {
+                std::unique_ptr<MemoryTiff> t(new MemoryTiff(_p,_n));
+
+                if(!t->is_open())
+                    break;
+
+                h.push_back(std::move(t));
+            }
+
+            if(h.empty())
+                return ParseStatus(ParseStatus::BadDirectory,_offsets[0]);
+
+            std::atomic<size_t> next(0);
+            std::mutex          m;
+            size_t              bad = pages;
+            ParseStatus         st;
+            std::exception_ptr  ex;
+
+            auto work = [&](TIFF * tif) {
+                try {
+                    for(size_t page;(page = next++)<pages;) {
+                        if(TIFFSetSubDirectory(tif,_offsets[page])==1) {
+                            f(page,tif);
+                            continue;
+                        }
+
+                        {
+                            std::lock_guard<std::mutex> l(m);
+
+                            if(page<bad) {
+                                bad = page;
+                                st  = ParseStatus(ParseStatus::BadDirectory,_offsets[page]);
+                            }
+                        }
+
+                        if(failed)
+                            f(page,NULL);
+                    }
+                } catch(...) {
+                    // Stop the others and pass the first one on
+
+                    std::lock_guard<std::mutex> l(m);
+
+                    next = pages;
+
+                    if(!ex)
+                        ex = std::current_exception();
+                }
+            };
+
+            std::vector<std::thread> t;
+
+            for(size_t i=1;i<h.size();i++)
+                t.emplace_back(work,h[i]->get());
+
+            work(h[0]->get());
+
+            for(std::thread & i : t)
+                i.join();
+
+            if(ex)
+                std::rethrow_exception(ex);
+
+            return st ? _st : st;
+        }
+    }
+}
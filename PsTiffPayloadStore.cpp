@@ -0,0 +1,417 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/payload_store.h>
+#include <pstiff/ResourceView.h>
+#include <pstiff/tools/hash.h>
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        namespace
+        {
+            const char Magic[8] = {'P','S','T','P','A','C','K','1'};
+
+            uint64_t Padded(uint64_t n) {
+                return (n+7) & ~(uint64_t)7;
+            }
+
+            void WriteAll(int fd,const void * p,size_t n,uint64_t off) {
+                for(size_t l=0;l<n;) {
+                    ssize_t r = ::pwrite(fd,(const Byte_t *)p+l,n-l,off+l);
+
+                    if(r<0 && errno==EINTR)
+                        continue;
+
+                    if(r<0)
+                        throw std::runtime_error(std::string("PayloadStore: write failed: ")+::strerror(errno));
+
+                    l += r;
+                }
+            }
+        }
+
+        bool PayloadStore::open(const std::string & path,bool write) {
+            close();
+
+            std::lock_guard<std::mutex> l(_m);
+
+            int         fd = ::open(path.c_str(),write ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC,0644);
+            struct stat st;
+
+            if(fd<0)
+                return false;
+
+            if(::fstat(fd,&st)!=0 || (st.st_size==0 && !write)) {
+                ::close(fd);
+                return false;
+            }
+
+            // A new pack
+
+            if(st.st_size==0) {
+                Header_t h;
+
+                ::memset(&h,0,sizeof(h));
+                ::memcpy(h.magic,Magic,sizeof(Magic));
+
+                h.order      = ByteOrder;
+                h.frame_size = sizeof(Frame_t);
+
+                try {
+                    WriteAll(fd,&h,sizeof(h),0);
+                } catch(...) {
+                    ::close(fd);
+                    return false;
+                }
+            }
+
+            std::unique_ptr<MappedFile> m(new MappedFile());
+            const Header_t *            h = NULL;
+
+            if(m->open(path) && m->size()>=sizeof(Header_t))
+                h = (const Header_t *)m->data();
+
+            if(h==NULL || ::memcmp(h->magic,Magic,sizeof(Magic))!=0 || h->order!=ByteOrder || h->frame_size!=sizeof(Frame_t)) {
+                ::close(fd);
+                return false;
+            }
+
+            _path   = path;
+            _mapped = m->size();
+            _maps.push_back(std::move(m));
+
+            // Frames up to the first one which doesn't fit. Frames don't
+            // get synced, after a crash one may have its header but not
+            // its data; the hash put() gave it has to come out again.
+
+            const Byte_t * p   = _maps.back()->data();
+            uint64_t       n   = _mapped;
+            uint64_t       off = sizeof(Header_t);
+
+            while(n-off>=sizeof(Frame_t)) {
+                Frame_t f;
+
+                ::memcpy(&f,p+off,sizeof(f));
+
+                uint64_t data = off+sizeof(Frame_t);
+
+                if((f.kind!=Payload && f.kind!=File) || f.size>n-data || Padded(f.size)>n-data)
+                    break;
+
+                Slot_t s = {data,f.size};
+
+                if(f.kind==Payload) {
+                    Hash_t h = Tools::hash64(p+data,f.size);
+
+                    while(_payloads.count(h)!=0)
+                        h++;
+
+                    if(h!=f.hash)
+                        break;
+
+                    _payloads.emplace(h,s);
+                } else {
+                    std::string file;
+                    Refs_t      refs;
+
+                    if(parse_file(p+data,f.size,file,refs))
+                        index_file(file,refs,s);
+                }
+
+                off = data+Padded(f.size);
+            }
+
+            _end = off;
+
+            if(!write) {
+                ::close(fd);
+            } else {
+                if(_end<n && ::ftruncate(fd,_end)!=0) {
+                    ::close(fd);
+                    return false;
+                }
+
+                // What gets appended there has to be mapped anew
+
+                _mapped = _end;
+                _fd     = fd;
+            }
+
+            return true;
+        }
+
+        void PayloadStore::close() {
+            std::lock_guard<std::mutex> l(_m);
+
+            if(_fd>=0)
+                ::close(_fd);
+
+            _path.clear();
+            _fd     = -1;
+            _end    = 0;
+            _mapped = 0;
+            _saved  = 0;
+            _maps.clear();
+            _payloads.clear();
+            _files.clear();
+            _users.clear();
+        }
+
+        size_t PayloadStore::size() const {
+            std::lock_guard<std::mutex> l(_m);
+            return _payloads.size();
+        }
+
+        size_t PayloadStore::get_files() const {
+            std::lock_guard<std::mutex> l(_m);
+            return _files.size();
+        }
+
+        uint64_t PayloadStore::get_saved() const {
+            std::lock_guard<std::mutex> l(_m);
+            return _saved;
+        }
+
+        uint64_t PayloadStore::append(Kind_t k,Hash_t h,const Byte_t * p,size_t n) {
+            if(_fd<0)
+                throw std::runtime_error("PayloadStore: '"+_path+"' is read only");
+
+            static const Byte_t Zero[8] = {0};
+
+            Frame_t f;
+
+            ::memset(&f,0,sizeof(f));
+
+            f.kind = k;
+            f.size = n;
+            f.hash = h;
+
+            // A frame left incomplete gets overwritten by the next one
+
+            WriteAll(_fd,&f,sizeof(f),_end);
+            WriteAll(_fd,p,n,_end+sizeof(f));
+            WriteAll(_fd,Zero,Padded(n)-n,_end+sizeof(f)+n);
+
+            uint64_t data = _end+sizeof(f);
+
+            _end = data+Padded(n);
+
+            return data;
+        }
+
+        const Byte_t * PayloadStore::at(uint64_t offset,uint64_t size) const {
+            if(offset+size>_mapped) {
+                std::unique_ptr<MappedFile> m(new MappedFile());
+
+                if(!m->open(_path) || m->size()<offset+size)
+                    throw std::runtime_error("PayloadStore: can't map '"+_path+"'");
+
+                _mapped = m->size();
+                _maps.push_back(std::move(m));
+            }
+
+            return _maps.back()->data()+offset;
+        }
+
+        const Byte_t * PayloadStore::read(uint64_t offset,uint64_t size,std::vector<Byte_t> & b) const {
+            if(offset+size<=_mapped)
+                return _maps.back()->data()+offset;
+
+            b.resize(size);
+
+            for(uint64_t l=0;l<size;) {
+                ssize_t r = ::pread(_fd,b.data()+l,size-l,offset+l);
+
+                if(r<0 && errno==EINTR)
+                    continue;
+
+                if(r<=0)
+                    throw std::runtime_error("PayloadStore: can't read '"+_path+"'");
+
+                l += r;
+            }
+
+            return b.data();
+        }
+
+        PayloadStore::Hash_t PayloadStore::put(const Byte_t * p,size_t n) {
+            Hash_t              h = Tools::hash64(p,n);
+            std::vector<Byte_t> b;
+
+            std::lock_guard<std::mutex> l(_m);
+
+            while(true) {
+                auto i = _payloads.find(h);
+
+                if(i==_payloads.end()) {
+                    Slot_t s = {append(Payload,h,p,n),n};
+                    _payloads.emplace(h,s);
+                    return h;
+                }
+
+                if(i->second.size==n && ::memcmp(read(i->second.offset,n,b),p,n)==0) {
+                    _saved += n;
+                    return h;
+                }
+
+                h++;
+            }
+        }
+
+        bool PayloadStore::get(Hash_t h,Span_t & s) const {
+            std::lock_guard<std::mutex> l(_m);
+
+            auto i = _payloads.find(h);
+
+            if(i==_payloads.end())
+                return false;
+
+            s = Span_t(at(i->second.offset,i->second.size),i->second.size);
+
+            return true;
+        }
+
+        void PayloadStore::put_resources(uint32_t page,const Byte_t * p,size_t n,size_t min,Refs_t & refs) {
+            ResourceBlocks(p,n).for_each([&](const ResourceView & v) {
+                if(v.get_data_size()>=min) {
+                    Ref_t r;
+
+                    r.page = page;
+                    r.id   = v.get_id_value();
+                    r.hash = put(v.get_data(),v.get_data_size());
+
+                    refs.push_back(r);
+                }
+                return true;
+            },Resync);
+        }
+
+        bool PayloadStore::parse_file(const Byte_t * p,size_t n,std::string & path,Refs_t & refs) const {
+            uint32_t l;
+            uint32_t c;
+
+            if(n<sizeof(l))
+                return false;
+
+            ::memcpy(&l,p,sizeof(l));
+
+            if(n-sizeof(l)<l || n-sizeof(l)-l<sizeof(c))
+                return false;
+
+            path.assign((const char *)p+sizeof(l),l);
+            p += sizeof(l)+l;
+            n -= sizeof(l)+l;
+
+            ::memcpy(&c,p,sizeof(c));
+            p += sizeof(c);
+            n -= sizeof(c);
+
+            if(n/sizeof(Ref_t)<c)
+                return false;
+
+            refs.resize(c);
+
+            if(c!=0)
+                ::memcpy(refs.data(),p,c*sizeof(Ref_t));
+
+            return true;
+        }
+
+        void PayloadStore::index_file(const std::string & path,const Refs_t & refs,const Slot_t & s) {
+            auto i = _files.find(path);
+
+            if(i!=_files.end()) {
+                std::string         old;
+                Refs_t              r;
+                std::vector<Byte_t> b;
+
+                if(parse_file(read(i->second.offset,i->second.size,b),i->second.size,old,r)) {
+                    for(const Ref_t & ref : r) {
+                        auto u = _users.find(ref.hash);
+
+                        if(u!=_users.end() && u->second.erase(path)!=0 && u->second.empty())
+                            _users.erase(u);
+                    }
+                }
+
+                i->second = s;
+            } else {
+                _files.emplace(path,s);
+            }
+
+            for(const Ref_t & ref : refs)
+                _users[ref.hash].insert(path);
+        }
+
+        void PayloadStore::add_file(const std::string & path,const Refs_t & refs) {
+            std::vector<Byte_t> b(sizeof(uint32_t)+path.size()+sizeof(uint32_t)+refs.size()*sizeof(Ref_t));
+            uint32_t            l = path.size();
+            uint32_t            c = refs.size();
+            Byte_t            * p = b.data();
+
+            ::memcpy(p,&l,sizeof(l));
+            ::memcpy(p+sizeof(l),path.data(),l);
+            ::memcpy(p+sizeof(l)+l,&c,sizeof(c));
+
+            if(c!=0)
+                ::memcpy(p+sizeof(l)+l+sizeof(c),refs.data(),c*sizeof(Ref_t));
+
+            std::lock_guard<std::mutex> lk(_m);
+
+            Slot_t s = {append(File,0,b.data(),b.size()),b.size()};
+
+            index_file(path,refs,s);
+        }
+
+        bool PayloadStore::get_refs(const std::string & path,Refs_t & refs) const {
+            std::lock_guard<std::mutex> l(_m);
+
+            auto i = _files.find(path);
+
+            if(i==_files.end())
+                return false;
+
+            std::string p;
+
+            return parse_file(at(i->second.offset,i->second.size),i->second.size,p,refs);
+        }
+
+        std::vector<std::string> PayloadStore::get_users(Hash_t h) const {
+            std::lock_guard<std::mutex> l(_m);
+
+            auto i = _users.find(h);
+
+            if(i==_users.end())
+                return std::vector<std::string>();
+
+            return std::vector<std::string>(i->second.begin(),i->second.end());
+        }
+    }
+}
@@ -0,0 +1,175 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/PsdReader.h>
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    ParseStatus PsdReader::read_header(const Byte_t * p,Header_t & h) {
+        if(::memcmp(p,"8BPS",4)!=0)
+            return ParseStatus(ParseStatus::BadPsdHeader,0);
+
+        h.version  = to16(p+4);
+        h.channels = to16(p+12);
+        h.height   = to32(p+14);
+        h.width    = to32(p+18);
+        h.depth    = to16(p+22);
+        h.mode     = to16(p+24);
+
+        if(h.version!=1 && h.version!=2)
+            return ParseStatus(ParseStatus::BadPsdHeader,4);
+
+        return ParseStatus();
+    }
+
+    ParseStatus PsdReader::find_resources(const Byte_t * p,size_t n,Header_t & h,uint64_t & off,uint64_t & len) {
+        if(p==NULL || n<HeaderSize)
+            return ParseStatus(ParseStatus::BadPsdHeader,0);
+
+        ParseStatus s = read_header(p,h);
+
+        if(!s)
+            return s;
+
+        // The color mode data, then the length of the resources
+
+        if(n-HeaderSize<4 || n-HeaderSize-4<to32(p+HeaderSize))
+            return ParseStatus(ParseStatus::BadSection,HeaderSize);
+
+        uint64_t o = HeaderSize + 4 + to32(p+HeaderSize);
+
+        if(n-o<4 || n-o-4<to32(p+o))
+            return ParseStatus(ParseStatus::BadSection,o);
+
+        off = o+4;
+        len = to32(p+o);
+
+        return ParseStatus();
+    }
+
+    bool PsdReader::open(const std::string & path) {
+        close();
+
+        if((_fd = ::open(path.c_str(),O_RDONLY|O_CLOEXEC))<0)
+            return false;
+
+        struct stat st;
+
+        if(::fstat(_fd,&st)!=0) {
+            close();
+            return false;
+        }
+
+        _size = st.st_size;
+
+        Byte_t h[HeaderSize+4];
+
+        if(!read(0,h,sizeof(h))) {
+            _st = ParseStatus(ParseStatus::BadPsdHeader,0);
+            return true;
+        }
+
+        if(!(_st = read_header(h,_h)))
+            return true;
+
+        // Skip the color mode data, a palette for indexed images and
+        // empty for most others
+
+        uint64_t o = HeaderSize + 4 + to32(h+HeaderSize);
+        Byte_t   l[4];
+
+        if(!read(o,l,4)) {
+            _st = ParseStatus(ParseStatus::BadSection,HeaderSize);
+            return true;
+        }
+
+        if(_size-o-4<to32(l)) {
+            _st = ParseStatus(ParseStatus::BadSection,o);
+            return true;
+        }
+
+        _offset = o+4;
+        _length = to32(l);
+
+        return true;
+    }
+
+    void PsdReader::close() {
+        if(_fd>=0)
+            ::close(_fd);
+
+        _fd     = -1;
+        _size   = 0;
+        _h      = Header_t();
+        _offset = 0;
+        _length = 0;
+        _st     = ParseStatus();
+    }
+
+    /** Read p[n] at off; false if the file ends before
+     */
+
+    bool PsdReader::read(uint64_t off,void * p,size_t n) {
+        if(off>_size || n>_size-off)
+            return false;
+
+        for(size_t l=0;l<n;) {
+            ssize_t r = ::pread(_fd,(Byte_t *)p+l,n-l,off+l);
+
+            if(r<0 && errno==EINTR)
+                continue;
+
+            if(r<0)
+                throw std::runtime_error(std::string("PsdReader: read failed: ")+::strerror(errno));
+
+            if(r==0)
+                return false;
+
+            l += r;
+        }
+
+        return true;
+    }
+
+    ParseStatus PsdReader::read_resources(Buffer_t & b,Memory_t * mr) {
+        if(!is_open())
+            return ParseStatus(ParseStatus::BadPsdHeader,0);
+
+        if(!_st)
+            return _st;
+
+        Byte_t * p = NULL;
+
+        b = make_buffer(_length,p,mr);
+
+        if(!read(_offset,p,_length))
+            return ParseStatus(ParseStatus::BadSection,_offset);
+
+        return ParseStatus();
+    }
+}
@@ -0,0 +1,695 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/Query.h>
+#include <pstiff/tools/strings.h>
+
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace PsTiff
+{
+    namespace
+    {
+        typedef enum {
+            Eq,
+            Ne,
+            Lt,
+            Le,
+            Gt,
+            Ge,
+            Contains
+        } Op_t;
+
+        typedef bool (*Each_t)(const Resource & r,const Query::Node_t & n);
+
+        /** A field of a typed resource; each() tells whether any of
+            its values passes the test of n
+         */
+
+        struct Field_t {
+            ResourceId::Enum_t e;
+            const char *       name;
+            bool               text;
+            Each_t             each;
+        };
+
+        template<class R,class F>
+        bool Any(const Resource & r,F f) {
+            const R * t = dynamic_cast<const R *>(&r);
+            return t!=NULL && f(*t);
+        }
+    }
+
+    /** A resource named in a query, by name or by number
+     */
+
+    struct Query::Ref_t {
+        ResourceId::Enum_t e;
+        int                id;    //< -1 if named
+
+        bool operator==(const Ref_t & o) const {
+            return e==o.e && id==o.id;
+        }
+
+        bool matches(const ResourceId & i) const {
+            return id<0 ? i.to_enum()==e : i.to_int()==id;
+        }
+    };
+
+    struct Query::Node_t {
+        typedef enum {
+            And,
+            Or,
+            Not,
+            Exists,
+            Size,
+            Field
+        } Kind_t;
+
+        Node_t(Kind_t k) : kind(k),ref(0),field(NULL),op(Eq),text(false),n(0) {
+        }
+
+        bool eval(Source_t & s) const;
+
+        bool test(int64_t v) const {
+            switch(op) {
+            case Eq: return v==n;
+            case Ne: return v!=n;
+            case Lt: return v<n;
+            case Le: return v<=n;
+            case Gt: return v>n;
+            case Ge: return v>=n;
+            default: return false;
+            }
+        }
+
+        bool test(std::string_view v) const {
+            switch(op) {
+            case Eq:       return v==s;
+            case Ne:       return v!=s;
+            case Lt:       return v<s;
+            case Le:       return v<=s;
+            case Gt:       return v>s;
+            case Ge:       return v>=s;
+            case Contains: return v.find(s)!=std::string_view::npos;
+            }
+            return false;
+        }
+
+        /** Photoshop keeps the terminating 0 of some names
+         */
+
+        bool test(std::wstring_view v) const {
+            while(!v.empty() && v.back()==0)
+                v.remove_suffix(1);
+
+            return test(std::string_view(Tools::from_wstring(v)));
+        }
+
+        Kind_t                  kind;
+        std::unique_ptr<Node_t> l;
+        std::unique_ptr<Node_t> r;
+        size_t                  ref;
+        const Field_t         * field;
+        Op_t                    op;
+        bool                    text;   //< s is what gets compared to, not n
+        int64_t                 n;
+        std::string             s;
+    };
+
+    namespace
+    {
+        const Field_t Fields[] = {
+            {ResourceId::AlternateSpotColors,"count",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<SpotColorResource>(r,[&](const SpotColorResource & t) {
+                    return n.test((int64_t)t.get_count());
+                });
+            }},
+            {ResourceId::AlternateSpotColors,"id",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<SpotColorResource>(r,[&](const SpotColorResource & t) {
+                    for(size_t i=0;i<t.get_count();i++)
+                        if(n.test((int64_t)t[i].id))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::AlternateSpotColors,"space",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<SpotColorResource>(r,[&](const SpotColorResource & t) {
+                    for(size_t i=0;i<t.get_count();i++)
+                        if(n.test((int64_t)t[i].sp))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::AlphaNames,"count",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<AlphaNamesResource>(r,[&](const AlphaNamesResource & t) {
+                    return n.test((int64_t)t.size());
+                });
+            }},
+            {ResourceId::AlphaNames,"name",true,[](const Resource & r,const Query::Node_t & n) {
+                return Any<AlphaNamesResource>(r,[&](const AlphaNamesResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test(std::string_view(t[i])))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::UnicodeAlphaNames,"count",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<UnicodeAlphaNamesResource>(r,[&](const UnicodeAlphaNamesResource & t) {
+                    return n.test((int64_t)t.size());
+                });
+            }},
+            {ResourceId::UnicodeAlphaNames,"name",true,[](const Resource & r,const Query::Node_t & n) {
+                return Any<UnicodeAlphaNamesResource>(r,[&](const UnicodeAlphaNamesResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test(std::wstring_view(t[i])))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::AlphaIdentifiers,"count",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<AlphaIdentifiersResource>(r,[&](const AlphaIdentifiersResource & t) {
+                    return n.test((int64_t)t.size());
+                });
+            }},
+            {ResourceId::AlphaIdentifiers,"id",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<AlphaIdentifiersResource>(r,[&](const AlphaIdentifiersResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test((int64_t)t[i]))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::IdSeedNumber,"seed",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<IdSeedNumberResource>(r,[&](const IdSeedNumberResource & t) {
+                    return n.test((int64_t)t.get_seed());
+                });
+            }},
+            {ResourceId::VersionInfo,"version",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<VersionInfoResource>(r,[&](const VersionInfoResource & t) {
+                    return n.test((int64_t)t.get_version());
+                });
+            }},
+            {ResourceId::VersionInfo,"merged",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<VersionInfoResource>(r,[&](const VersionInfoResource & t) {
+                    return n.test((int64_t)t.has_merged_data());
+                });
+            }},
+            {ResourceId::VersionInfo,"reader",true,[](const Resource & r,const Query::Node_t & n) {
+                return Any<VersionInfoResource>(r,[&](const VersionInfoResource & t) {
+                    return n.test(t.get_reader_name());
+                });
+            }},
+            {ResourceId::VersionInfo,"writer",true,[](const Resource & r,const Query::Node_t & n) {
+                return Any<VersionInfoResource>(r,[&](const VersionInfoResource & t) {
+                    return n.test(t.get_writer_name());
+                });
+            }},
+            {ResourceId::DisplayInfo,"count",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<DisplayInfoResource>(r,[&](const DisplayInfoResource & t) {
+                    return n.test((int64_t)t.size());
+                });
+            }},
+            {ResourceId::DisplayInfo,"space",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<DisplayInfoResource>(r,[&](const DisplayInfoResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test((int64_t)t[i].colorspace))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::DisplayInfo,"opacity",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<DisplayInfoResource>(r,[&](const DisplayInfoResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test((int64_t)t[i].opacity))
+                            return true;
+                    return false;
+                });
+            }},
+            {ResourceId::DisplayInfo,"kind",false,[](const Resource & r,const Query::Node_t & n) {
+                return Any<DisplayInfoResource>(r,[&](const DisplayInfoResource & t) {
+                    for(size_t i=0;i<t.size();i++)
+                        if(n.test((int64_t)t[i].kind))
+                            return true;
+                    return false;
+                });
+            }}
+        };
+
+        /** Recursive descent over the text of a query:
+
+              or     := and { 'or' and }
+              and    := not { 'and' not }
+              not    := 'not' not | '(' or ')' | ref [ '.' field op literal ]
+              ref    := name | number
+         */
+
+        class Parser {
+        public:
+            Parser(const std::string & text,std::vector<Query::Ref_t> & refs) : _t(text),_i(0),_refs(refs) {
+            }
+
+            std::unique_ptr<Query::Node_t> parse() {
+                std::unique_ptr<Query::Node_t> n = parse_or();
+
+                skip();
+
+                if(_i!=_t.size())
+                    fail("unexpected '"+_t.substr(_i,1)+"'");
+
+                return n;
+            }
+
+        private:
+            typedef Query::Node_t Node_t;
+            typedef Query::Ref_t  Ref_t;
+
+            [[noreturn]]
+            void fail(const std::string & what) const {
+                throw std::runtime_error("Query: "+what+" at "+std::to_string(_i)+" in '"+_t+"'");
+            }
+
+            void skip() {
+                while(_i<_t.size() && ::isspace((unsigned char)_t[_i]))
+                    _i++;
+            }
+
+            /** Take s if it comes next; words only when not followed
+                by more of a word
+             */
+
+            bool take(const char * s) {
+                skip();
+
+                size_t l = ::strlen(s);
+
+                if(_t.compare(_i,l,s)!=0)
+                    return false;
+
+                if(::isalpha((unsigned char)s[0]) && _i+l<_t.size() && (::isalnum((unsigned char)_t[_i+l]) || _t[_i+l]=='_'))
+                    return false;
+
+                _i += l;
+
+                return true;
+            }
+
+            std::string word() {
+                skip();
+
+                size_t b = _i;
+
+                while(_i<_t.size() && (::isalnum((unsigned char)_t[_i]) || _t[_i]=='_'))
+                    _i++;
+
+                return _t.substr(b,_i-b);
+            }
+
+            int64_t number() {
+                skip();
+
+                const char * b = _t.c_str()+_i;
+                char *       e;
+                int64_t      v = ::strtoll(b,&e,0);
+
+                if(e==b)
+                    fail("expected a number");
+
+                _i += e-b;
+
+                return v;
+            }
+
+            std::string text() {
+                skip();
+
+                char        q = _t[_i++];
+                std::string s;
+
+                while(_i<_t.size() && _t[_i]!=q) {
+                    if(_t[_i]=='\\' && _i+1<_t.size())
+                        _i++;
+                    s += _t[_i++];
+                }
+
+                if(_i==_t.size())
+                    fail("unterminated string");
+
+                _i++;
+
+                return s;
+            }
+
+            std::unique_ptr<Node_t> join(Node_t::Kind_t k,std::unique_ptr<Node_t> l,std::unique_ptr<Node_t> r) {
+                std::unique_ptr<Node_t> n(new Node_t(k));
+
+                n->l = std::move(l);
+                n->r = std::move(r);
+
+                return n;
+            }
+
+            std::unique_ptr<Node_t> parse_or() {
+                std::unique_ptr<Node_t> n = parse_and();
+
+                while(take("or") || take("||"))
+                    n = join(Node_t::Or,std::move(n),parse_and());
+
+                return n;
+            }
+
+            std::unique_ptr<Node_t> parse_and() {
+                std::unique_ptr<Node_t> n = parse_not();
+
+                while(take("and") || take("&&"))
+                    n = join(Node_t::And,std::move(n),parse_not());
+
+                return n;
+            }
+
+            std::unique_ptr<Node_t> parse_not() {
+                if(take("not") || take("!"))
+                    return join(Node_t::Not,parse_not(),NULL);
+
+                if(take("(")) {
+                    std::unique_ptr<Node_t> n = parse_or();
+
+                    if(!take(")"))
+                        fail("expected ')'");
+
+                    return n;
+                }
+
+                return parse_predicate();
+            }
+
+            std::unique_ptr<Node_t> parse_predicate() {
+                Ref_t r;
+
+                skip();
+
+                if(_i<_t.size() && ::isdigit((unsigned char)_t[_i])) {
+                    int64_t id = number();
+
+                    if(id<0 || id>0xffff)
+                        fail("no such resource id");
+
+                    r.id = id;
+                    r.e  = ResourceId::to_enum(id);
+                } else {
+                    std::string name = word();
+
+                    if(name.empty())
+                        fail("expected a resource");
+
+                    r.id = -1;
+                    r.e  = ResourceId::from_name(name);
+
+                    if(r.e==ResourceId::Unknown)
+                        fail("unknown resource '"+name+"'");
+                }
+
+                std::unique_ptr<Node_t> n(new Node_t(Node_t::Exists));
+
+                n->ref = add(r);
+
+                if(!take("."))
+                    return n;
+
+                std::string field = word();
+
+                if(field=="size") {
+                    n->kind = Node_t::Size;
+                } else {
+                    for(const Field_t & f : Fields) {
+                        if(f.e==r.e && field==f.name)
+                            n->field = &f;
+                    }
+
+                    if(n->field==NULL)
+                        fail("no field '"+field+"' in "+ResourceId::to_name(r.e));
+
+                    n->kind = Node_t::Field;
+                }
+
+                bool text = n->field!=NULL && n->field->text;
+
+                if(take("contains"))      n->op = Contains;
+                else if(take("=="))       n->op = Eq;
+                else if(take("!="))       n->op = Ne;
+                else if(take("<="))       n->op = Le;
+                else if(take(">="))       n->op = Ge;
+                else if(take("="))        n->op = Eq;
+                else if(take("<"))        n->op = Lt;
+                else if(take(">"))        n->op = Gt;
+                else                      fail("expected a comparison");
+
+                if(n->op==Contains && !text)
+                    fail("contains needs a text field");
+
+                skip();
+
+                n->text = _i<_t.size() && (_t[_i]=='\'' || _t[_i]=='"');
+
+                if(n->text!=text)
+                    fail(text ? "expected a string" : "expected a number");
+
+                if(text)
+                    n->s = this->text();
+                else
+                    n->n = number();
+
+                return n;
+            }
+
+            size_t add(const Ref_t & r) {
+                for(size_t i=0;i<_refs.size();i++) {
+                    if(_refs[i]==r)
+                        return i;
+                }
+
+                _refs.push_back(r);
+
+                return _refs.size()-1;
+            }
+
+            const std::string &  _t;
+            size_t               _i;
+            std::vector<Query::Ref_t> & _refs;
+        };
+    }
+
+    /** What a query runs on: the blocks of each resource it names,
+        decoded on demand
+     */
+
+    class Query::Source_t {
+    public:
+        virtual
+        ~Source_t() {
+        }
+
+        virtual size_t count(size_t ref) const = 0;
+        virtual uint32_t get_size(size_t ref,size_t i) const = 0;
+
+        /** Whether block i of ref passes its validator
+         */
+
+        virtual bool is_valid(size_t ref,size_t i) = 0;
+
+        /** Block i of ref decoded, NULL if it can't be
+         */
+
+        virtual const Resource * get(size_t ref,size_t i) = 0;
+    };
+
+    namespace
+    {
+        class BlobSource : public Query::Source_t {
+        public:
+            BlobSource(const Byte_t * p,size_t n,const ResourceDecoder & dec,const std::vector<Query::Ref_t> & refs)
+                : _dec(dec),_blocks(refs.size()) {
+                // Headers only; nothing gets decoded here
+
+                ResourceBlocks(p,n).for_each([&](const ResourceView & v) {
+                    for(size_t i=0;i<refs.size();i++) {
+                        if(refs[i].matches(v.get_id()))
+                            _blocks[i].push_back(Block_t(v));
+                    }
+                    return true;
+                },Resync);
+            }
+
+            virtual size_t count(size_t ref) const {
+                return _blocks[ref].size();
+            }
+
+            virtual uint32_t get_size(size_t ref,size_t i) const {
+                return _blocks[ref][i].v.get_data_size();
+            }
+
+            virtual bool is_valid(size_t ref,size_t i) {
+                Block_t & b = _blocks[ref][i];
+
+                if(b.valid<0)
+                    b.valid = _dec.validate(b.v) ? 1 : 0;
+
+                return b.valid!=0;
+            }
+
+            virtual const Resource * get(size_t ref,size_t i) {
+                Block_t & b = _blocks[ref][i];
+
+                if(!b.tried) {
+                    b.tried = true;
+
+                    if(is_valid(ref,i)) {
+                        try {
+                            b.r = _dec.decode(b.v,&_mr);
+                        } catch(const std::exception &) {
+                        }
+                    }
+                }
+
+                return b.r.get();
+            }
+
+        private:
+            struct Block_t {
+                Block_t(const ResourceView & vv) : v(vv),valid(-1),tried(false) {
+                }
+
+                ResourceView                v;
+                ResourceDecoder::Result_t   r;
+                int                         valid;  //< -1 until validated
+                bool                        tried;
+            };
+
+            const ResourceDecoder &              _dec;
+            std::pmr::monotonic_buffer_resource  _mr;
+            std::vector<std::vector<Block_t>>    _blocks;
+        };
+
+        class ListSource : public Query::Source_t {
+        public:
+            ListSource(const ResourceList & l,const std::vector<Query::Ref_t> & refs) : _l(l),_blocks(refs.size()) {
+                for(size_t j=0;j<l.size();j++) {
+                    for(size_t i=0;i<refs.size();i++) {
+                        if(refs[i].matches(l[j].get_id()))
+                            _blocks[i].push_back(j);
+                    }
+                }
+            }
+
+            virtual size_t count(size_t ref) const {
+                return _blocks[ref].size();
+            }
+
+            virtual uint32_t get_size(size_t ref,size_t i) const {
+                return _l[_blocks[ref][i]].get_data_size();
+            }
+
+            virtual bool is_valid(size_t,size_t) {
+                return true;
+            }
+
+            virtual const Resource * get(size_t ref,size_t i) {
+                return &_l[_blocks[ref][i]];
+            }
+
+        private:
+            const ResourceList &             _l;
+            std::vector<std::vector<size_t>> _blocks;
+        };
+    }
+
+    bool Query::Node_t::eval(Source_t & src) const {
+        switch(kind) {
+        case And:
+            return l->eval(src) && r->eval(src);
+
+        case Or:
+            return l->eval(src) || r->eval(src);
+
+        case Not:
+            return !l->eval(src);
+
+        case Exists:
+            for(size_t i=0;i<src.count(ref);i++) {
+                if(src.is_valid(ref,i))
+                    return true;
+            }
+            return false;
+
+        case Size:
+            for(size_t i=0;i<src.count(ref);i++) {
+                if(src.is_valid(ref,i) && test((int64_t)src.get_size(ref,i)))
+                    return true;
+            }
+            return false;
+
+        case Field:
+            for(size_t i=0;i<src.count(ref);i++) {
+                const Resource * res = src.get(ref,i);
+
+                if(res!=NULL && field->each(*res,*this))
+                    return true;
+            }
+            return false;
+        }
+
+        return false;
+    }
+
+    Query::Query(const std::string & text) : _text(text) {
+        _root = Parser(_text,_refs).parse();
+
+        for(const Ref_t & r : _refs)
+            _ids.push_back(r.e);
+    }
+
+    Query::~Query() {
+    }
+
+    bool Query::is_typed(const ResourceDecoder & dec) const {
+        for(ResourceId::Enum_t e : _ids) {
+            if(!dec.has(e))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Query::match(const Byte_t * p,size_t n,const ResourceDecoder & dec) const {
+        BlobSource s(p,n,dec,_refs);
+        return _root->eval(s);
+    }
+
+    bool Query::match(const ResourceList & l) const {
+        ListSource s(l,_refs);
+        return _root->eval(s);
+    }
+}
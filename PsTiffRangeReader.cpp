@@ -0,0 +1,391 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/io/range_reader.h>
+#include <pstiff/TiffWalker.h>
+
+#include <algorithm>
+#include <set>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    namespace IO
+    {
+        bool RangeReader::open(const std::string & path,const Options_t & o) {
+            close();
+
+            _o = o;
+
+            if(_o.block_size==0)
+                _o.block_size = Options_t().block_size;
+
+            if(_o.cache_blocks==0)
+                _o.cache_blocks = 1;
+
+            if((_fd = ::open(path.c_str(),O_RDONLY))<0)
+                return false;
+
+            struct stat st;
+
+            if(::fstat(_fd,&st)!=0) {
+                close();
+                return false;
+            }
+
+            _size = st.st_size;
+            _cache.reserve(_o.cache_blocks);
+
+            return true;
+        }
+
+        void RangeReader::close() {
+            if(_fd>=0)
+                ::close(_fd);
+
+            _fd   = -1;
+            _size = 0;
+            _pos  = 0;
+            _cache.clear();
+            _want.clear();
+        }
+
+        size_t RangeReader::pread(uint64_t off,void * p,size_t n) {
+            if(_o.latency.count()>0)
+                std::this_thread::sleep_for(_o.latency);
+
+            _stats.requests++;
+
+            size_t l = 0;
+
+            while(l<n) {
+                ssize_t r = ::pread(_fd,(Byte_t *)p+l,n-l,off+l);
+
+                if(r<0 && errno==EINTR)
+                    continue;
+
+                if(r<=0)
+                    break;
+
+                l += r;
+            }
+
+            _stats.bytes += l;
+
+            return l;
+        }
+
+        RangeReader::Block_t * RangeReader::find(uint64_t b) {
+            for(Block_t & k : _cache)
+                if(k.index==b)
+                    return &k;
+            return NULL;
+        }
+
+        RangeReader::Block_t * RangeReader::slot() {
+            if(_cache.size()<_o.cache_blocks) {
+                _cache.emplace_back();
+                return &_cache.back();
+            }
+
+            return &*std::min_element(_cache.begin(),_cache.end(),[](const Block_t & a,const Block_t & b) {
+                return a.tick<b.tick;
+            });
+        }
+
+        /** Read the blocks [b0;b1] with a single request
+         */
+
+        void RangeReader::load(uint64_t b0,uint64_t b1) {
+            uint64_t o = b0 * _o.block_size;
+            uint64_t e = std::min<uint64_t>(_size,(b1+1) * _o.block_size);
+
+            _buf.resize(e-o);
+
+            size_t l = pread(o,_buf.data(),_buf.size());
+
+            for(uint64_t b=b0,i=0;b<=b1 && i<l;b++,i+=_o.block_size) {
+                Block_t * k = find(b);
+
+                if(k==NULL) {
+                    k = slot();
+                    _stats.misses++;
+                }
+
+                k->index = b;
+                k->tick  = ++_tick;
+                k->data.assign(_buf.data()+i,_buf.data()+std::min<uint64_t>(l,i+_o.block_size));
+            }
+        }
+
+        void RangeReader::want(uint64_t off,uint64_t n) {
+            if(n==0 || off>=_size)
+                return;
+
+            n = std::min<uint64_t>(n,_size-off);
+
+            uint64_t b0 = off / _o.block_size;
+            uint64_t b1 = std::min<uint64_t>((off+n-1) / _o.block_size,b0+get_limit()-1);
+
+            for(uint64_t b=b0;b<=b1;b++)
+                _want.push_back(b);
+        }
+
+        /** Load all missing blocks in _want. Misses which are at most
+            max_gap blocks apart are merged into one request and the
+            blocks in between are read along.
+         */
+
+        void RangeReader::fetch() {
+            std::sort(_want.begin(),_want.end());
+            _want.erase(std::unique(_want.begin(),_want.end()),_want.end());
+
+            size_t i = 0;
+
+            while(i<_want.size()) {
+                if(find(_want[i])!=NULL) {
+                    i++;
+                    continue;
+                }
+
+                uint64_t b0 = _want[i];
+                uint64_t b1 = b0;
+
+                for(i++;i<_want.size();i++) {
+                    uint64_t b = _want[i];
+
+                    if(find(b)!=NULL)
+                        continue;
+
+                    if(b-b1-1>_o.max_gap || b-b0+1>get_limit())
+                        break;
+
+                    b1 = b;
+                }
+
+                load(b0,b1);
+            }
+
+            _want.clear();
+        }
+
+        void RangeReader::prefetch(uint64_t off,size_t n) {
+            if(!is_open())
+                return;
+
+            want(off,n);
+            fetch();
+        }
+
+        size_t RangeReader::read(uint64_t off,void * p,size_t n) {
+            if(!is_open() || off>=_size || n==0)
+                return 0;
+
+            n = std::min<uint64_t>(n,_size-off);
+
+            uint64_t b0 = off / _o.block_size;
+            uint64_t b1 = (off+n-1) / _o.block_size;
+
+            // Strip and tile data is read once, keep it out of the cache
+
+            if(b1-b0+1>get_limit())
+                return pread(off,p,n);
+
+            bool miss = false;
+
+            for(uint64_t b=b0;b<=b1;b++) {
+                Block_t * k = find(b);
+
+                if(k!=NULL) {
+                    k->tick = ++_tick;
+                    _stats.hits++;
+                } else {
+                    miss = true;
+                }
+            }
+
+            if(miss) {
+                uint64_t r = std::min<uint64_t>(_o.readahead,get_limit()-(b1-b0+1));
+
+                want(off,n);
+
+                if(r>0 && b1+1<get_block_count())
+                    want((b1+1) * _o.block_size,r * _o.block_size);
+
+                fetch();
+            }
+
+            size_t l = 0;
+
+            for(uint64_t b=b0;b<=b1 && l<n;b++) {
+                Block_t * k = find(b);
+                uint64_t  o = off + l - b * _o.block_size;
+
+                if(k==NULL)
+                    return l + pread(off+l,(Byte_t *)p+l,n-l);
+
+                if(o>=k->data.size())
+                    break;
+
+                size_t c = std::min<uint64_t>(n-l,k->data.size()-o);
+
+                ::memcpy((Byte_t *)p+l,k->data.data()+o,c);
+                l += c;
+            }
+
+            return l;
+        }
+
+        /** Follow the directory chain. Each directory, the out of line
+            payloads libtiff reads along with it and the head of the
+            next directory are fetched together, which leaves one round
+            trip per page.
+         */
+
+        void RangeReader::prefetch_directories() {
+            Byte_t     h[16];
+            TiffFormat f;
+            uint64_t   off;
+
+            if(read(0,h,TiffFormat::MinHeaderSize)!=TiffFormat::MinHeaderSize)
+                return;
+
+            size_t l = TiffFormat::get_header_size(h);
+
+            if(l>TiffFormat::MinHeaderSize && read(0,h,l)!=l)
+                return;
+
+            if(!f.read_header(h,l,off))
+                return;
+
+            std::set<uint64_t>  seen;
+            std::vector<Byte_t> e;
+            uint64_t            m  = _stats.misses;
+            uint64_t            cs = f.get_count_size();
+            uint64_t            es = f.get_entry_size();
+            uint64_t            ws = f.get_word_size();
+
+            // Don't let the prefetch evict what it fetched itself
+
+            while(off!=0 && seen.insert(off).second && _stats.misses-m<get_limit()) {
+                Byte_t c[8];
+
+                if(read(off,c,cs)!=cs)
+                    return;
+
+                uint64_t n = f.get_count(c);
+
+                if(n>(_size-std::min(_size,off))/es)
+                    return;
+
+                e.resize(n*es+ws);
+
+                if(read(off+cs,e.data(),e.size())!=e.size())
+                    return;
+
+                uint64_t next = f.get_word(e.data()+n*es);
+
+                for(uint64_t i=0;i<n;i++) {
+                    const Byte_t * p = e.data()+i*es;
+                    uint16_t       t = f.get_tag(p);
+                    uint64_t       s = f.get_value_count(p) * TiffWalker::get_type_size(f.get_type(p));
+
+                    if(s<=ws)
+                        continue;
+
+                    if(t==TiffWalker::TagPhotoshop || t==TiffWalker::TagXmp || t==TiffWalker::TagPhotoshopDdb || s<=4*_o.block_size)
+                        want(f.get_word(p+f.get_value_pos()),s);
+                }
+
+                // Pages tend to look alike, guess the next directory has as
+                // many entries. Read ahead only where read() would, on a miss.
+
+                want(next,f.get_directory_size(n)+(find(next/_o.block_size)==NULL ? _o.readahead*_o.block_size : 0));
+                fetch();
+
+                off = next;
+            }
+        }
+
+        TIFF * RangeReader::open_tiff(const char * name) {
+            if(!is_open())
+                return NULL;
+
+            if(_o.prefetch)
+                prefetch_directories();
+
+            _pos = 0;
+
+            return TIFFClientOpen(name,"rm",(thandle_t)this,Read,Write,Seek,Close,Size,Map,Unmap);
+        }
+
+        tmsize_t RangeReader::Read(thandle_t h,void * p,tmsize_t n) {
+            RangeReader * r = (RangeReader *)h;
+
+            if(n<=0)
+                return 0;
+
+            size_t l = r->read(r->_pos,p,n);
+            r->_pos += l;
+
+            return (tmsize_t)l;
+        }
+
+        tmsize_t RangeReader::Write(thandle_t,void *,tmsize_t) {
+            return -1;
+        }
+
+        toff_t RangeReader::Seek(thandle_t h,toff_t o,int w) {
+            RangeReader * r = (RangeReader *)h;
+
+            switch(w) {
+            case SEEK_SET: r->_pos  = o;             break;
+            case SEEK_CUR: r->_pos += o;             break;
+            case SEEK_END: r->_pos  = r->_size + o;  break;
+            default:
+                return (toff_t)-1;
+            }
+
+            return r->_pos;
+        }
+
+        int RangeReader::Close(thandle_t) {
+            return 0;
+        }
+
+        toff_t RangeReader::Size(thandle_t h) {
+            return ((RangeReader *)h)->_size;
+        }
+
+        int RangeReader::Map(thandle_t,void **,toff_t *) {
+            return 0;
+        }
+
+        void RangeReader::Unmap(thandle_t,void *,toff_t) {
+        }
+    }
+}
@@ -0,0 +1,219 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/ResourceList.h>
+#include <pstiff/PsdReader.h>
+#include <pstiff/JpegReader.h>
+#include <pstiff/TiffCopy.h>
+#include <pstiff/io/memory_tiff.h>
+
+#include <string.h>
+#include <sys/stat.h>
+
+namespace PsTiff
+{
+    void ResourceList::read(const Byte_t * p,size_t n,const ResourceDecoder & d) {
+        try_read(p,n,d).check();
+    }
+
+    void ResourceList::read(const Buffer_t & b,size_t n,const ResourceDecoder & d) {
+        try_read(b,n,d).check();
+    }
+
+    ParseStatus ResourceList::try_read(const Byte_t * p,size_t n,const ResourceDecoder & d,
+                                       ParsePolicy_t pol,ParseDiagnostics * diag) {
+        Byte_t * c = NULL;
+        Buffer_t b = make_buffer(n,c,get_memory_resource());
+
+        ::memcpy(c,p,n);
+
+        return try_read(b,n,d,pol,diag);
+    }
+
+    ParseStatus ResourceList::try_read(const Buffer_t & b,size_t n,const ResourceDecoder & d,
+                                       ParsePolicy_t pol,ParseDiagnostics * diag) {
+        clear();
+
+        return d.try_decode(b.get(),n,[this,&b](const ResourceView &,ResourceDecoder::Result_t r) {
+            r->keep_alive(b);
+            _v.push_back(settle(entry_t(std::move(r))));
+        },pol,diag,get_memory_resource());
+    }
+
+    bool ResourceList::read(TIFF * in,const ResourceDecoder & d) {
+        uint32_t n    = 0;
+        void   * data = NULL;
+
+        clear();
+
+        if(in==NULL || TIFFGetField(in,TIFFTAG_PHOTOSHOP,&n,&data)!=1 || data==NULL)
+            return false;
+
+        read((const Byte_t *)data,n,d);
+        return true;
+    }
+
+    bool ResourceList::write(TIFF * out) {
+        if(out==NULL)
+            return false;
+
+        uint32_t s = get_size();
+
+        return TIFFSetField(out,TIFFTAG_PHOTOSHOP,s,get_raw())==1;
+    }
+
+    bool ResourceList::read(const std::string & path,const ResourceDecoder & d) {
+        TIFF * in = TIFFOpen(path.c_str(),"r");
+
+        if(in==NULL)
+            return false;
+
+        bool r = read(in,d);
+
+        TIFFClose(in);
+
+        return r;
+    }
+
+    bool ResourceList::read_tiff(const Byte_t * tiff,size_t n,const ResourceDecoder & d) {
+        IO::MemoryTiff in(tiff,n);
+
+        return in.is_open() && read(in.get(),d);
+    }
+
+    bool ResourceList::read_psd(const std::string & path,const ResourceDecoder & d) {
+        PsdReader in;
+        Buffer_t  b;
+
+        clear();
+
+        if(!in.open(path) || !in.read_resources(b,get_memory_resource()))
+            return false;
+
+        read(b,in.get_resources_size(),d);
+        return true;
+    }
+
+    bool ResourceList::read_psd(const Byte_t * psd,size_t n,const ResourceDecoder & d) {
+        PsdReader::Header_t h;
+        uint64_t            off;
+        uint64_t            len;
+
+        clear();
+
+        if(!PsdReader::find_resources(psd,n,h,off,len))
+            return false;
+
+        read(psd+off,len,d);
+        return true;
+    }
+
+    bool ResourceList::read_jpeg(const std::string & path,const ResourceDecoder & d) {
+        JpegReader in;
+        Buffer_t   b;
+
+        clear();
+
+        if(!in.open(path) || !in.read_resources(b,get_memory_resource()))
+            return false;
+
+        read(b,in.get_resources_size(),d);
+        return true;
+    }
+
+    bool ResourceList::read_jpeg(const Byte_t * jpeg,size_t n,const ResourceDecoder & d) {
+        JpegReader::Parts_t parts;
+
+        clear();
+
+        if(!JpegReader::find_resources(jpeg,n,parts))
+            return false;
+
+        // A single segment can be parsed in place
+
+        if(parts.size()==1) {
+            read(jpeg+parts[0].offset,parts[0].size,d);
+            return true;
+        }
+
+        uint64_t l = 0;
+
+        for(const JpegReader::Part_t & r : parts)
+            l += r.size;
+
+        Byte_t * p = NULL;
+        Buffer_t b = make_buffer(l,p,get_memory_resource());
+
+        for(const JpegReader::Part_t & r : parts) {
+            ::memcpy(p,jpeg+r.offset,r.size);
+            p += r.size;
+        }
+
+        read(b,l,d);
+        return true;
+    }
+
+    bool ResourceList::write_tiff(std::vector<Byte_t> & tiff) {
+        IO::MemoryTiff out(tiff,"r+");
+
+        return out.is_open() && write(out.get()) && TIFFRewriteDirectory(out.get())==1;
+    }
+
+    bool ResourceList::write(const std::string & path) {
+        TIFF * out = TIFFOpen(path.c_str(),"r+");
+
+        if(out==NULL)
+            return false;
+
+        bool r = write(out) && TIFFRewriteDirectory(out)==1;
+
+        TIFFClose(out);
+
+        return r;
+    }
+
+    bool ResourceList::write(const std::string & from,const std::string & to) {
+        TIFF * in = TIFFOpen(from.c_str(),"r");
+
+        if(in==NULL)
+            return false;
+
+        // The copy is about as big as the original plus the new
+        // Resources; a classic TIFF growing past 4 GB becomes a BigTIFF
+
+        struct stat st;
+
+        TIFF * out = ::stat(from.c_str(),&st)==0 ? TIFFOpen(to.c_str(),TiffCopy::get_write_mode(st.st_size+get_size())) : NULL;
+
+        if(out==NULL) {
+            TIFFClose(in);
+            return false;
+        }
+
+        bool r = TiffCopy::copy(in,out,[this](size_t page) {
+            return page==0 ? this : NULL;
+        });
+
+        TIFFClose(out);
+        TIFFClose(in);
+
+        return r;
+    }
+}
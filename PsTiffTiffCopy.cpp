@@ -0,0 +1,306 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/TiffCopy.h>
+#include <pstiff/ResourceList.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+namespace PsTiff
+{
+    namespace
+    {
+        template<class T>
+        void Copy(TIFF * in,TIFF * out,uint32_t tag) {
+            T v;
+            if(TIFFGetField(in,tag,&v)==1)
+                TIFFSetField(out,tag,v);
+        }
+
+        template<class T>
+        void CopyPair(TIFF * in,TIFF * out,uint32_t tag) {
+            T a,b;
+            if(TIFFGetField(in,tag,&a,&b)==1)
+                TIFFSetField(out,tag,a,b);
+        }
+
+        /** Field names handed to TIFFMergeFieldInfo() have to outlive
+            the handle; the anonymous ones of in go with in.
+         */
+
+        const char * KeepName(const char * n) {
+            static std::mutex            m;
+            static std::set<std::string> names;
+
+            std::lock_guard<std::mutex> l(m);
+
+            return names.insert(n!=NULL ? n : "").first->c_str();
+        }
+
+        /** Copy a tag libtiff keeps among the custom values, i.e.
+            all but the core ones
+         */
+
+        void CopyCustom(TIFF * in,TIFF * out,uint32_t tag) {
+            const TIFFField * f = TIFFFindField(in,tag,TIFF_ANY);
+
+            if(f==NULL)
+                return;
+
+            const TIFFField * o = TIFFFindField(out,tag,TIFF_ANY);
+
+            if(o==NULL) {
+                TIFFFieldInfo fi;
+
+                fi.field_tag        = tag;
+                fi.field_readcount  = TIFFFieldReadCount(f);
+                fi.field_writecount = TIFFFieldWriteCount(f);
+                fi.field_type       = TIFFFieldDataType(f);
+                fi.field_bit        = FIELD_CUSTOM;
+                fi.field_oktochange = 1;
+                fi.field_passcount  = TIFFFieldPassCount(f);
+                fi.field_name       = const_cast<char *>(KeepName(TIFFFieldName(f)));
+
+                if(TIFFMergeFieldInfo(out,&fi,1)!=0 || (o = TIFFFindField(out,tag,TIFF_ANY))==NULL)
+                    return;
+            }
+
+            // These four come in pairs rather than as arrays
+
+            if(tag==TIFFTAG_PAGENUMBER || tag==TIFFTAG_HALFTONEHINTS || tag==TIFFTAG_YCBCRSUBSAMPLING || tag==TIFFTAG_DOTRANGE) {
+                CopyPair<uint16_t>(in,out,tag);
+                return;
+            }
+
+            if(TIFFFieldPassCount(f)) {
+                void * d = NULL;
+
+                if(TIFFFieldReadCount(f)==TIFF_VARIABLE2) {
+                    uint32_t n;
+                    if(TIFFGetField(in,tag,&n,&d)==1)
+                        TIFFSetField(out,tag,n,d);
+                } else {
+                    uint16_t n;
+                    if(TIFFGetField(in,tag,&n,&d)==1)
+                        TIFFSetField(out,tag,(int)n,d);
+                }
+                return;
+            }
+
+            if(TIFFFieldDataType(f)==TIFF_ASCII || TIFFFieldReadCount(f)!=1) {
+                Copy<void *>(in,out,tag);
+                return;
+            }
+
+            switch(TIFFFieldDataType(f)) {
+            case TIFF_BYTE:
+            case TIFF_SBYTE:
+            case TIFF_UNDEFINED:
+                Copy<uint8_t>(in,out,tag);
+                break;
+            case TIFF_SHORT:
+            case TIFF_SSHORT:
+                Copy<uint16_t>(in,out,tag);
+                break;
+            case TIFF_LONG:
+            case TIFF_SLONG:
+            case TIFF_IFD:
+                Copy<uint32_t>(in,out,tag);
+                break;
+            case TIFF_LONG8:
+            case TIFF_SLONG8:
+            case TIFF_IFD8:
+                Copy<uint64_t>(in,out,tag);
+                break;
+            case TIFF_FLOAT:
+                Copy<float>(in,out,tag);
+                break;
+            case TIFF_DOUBLE:
+                Copy<double>(in,out,tag);
+                break;
+            default:
+                // Single rationals are read as float or double depending on
+                // the tag and the libtiff version; better leave them out
+                break;
+            }
+        }
+    }
+
+    bool TiffCopy::copy_tags(TIFF * in,TIFF * out,bool photoshop) {
+        if(in==NULL || out==NULL)
+            return false;
+
+        // The core tags in an order libtiff accepts them in, e.g. the
+        // compression before the codec's tags, the samples before the
+        // extra samples and the colour map after the bits per sample
+
+        static const uint32_t Longs[]  = {TIFFTAG_SUBFILETYPE,TIFFTAG_IMAGEWIDTH,TIFFTAG_IMAGELENGTH,TIFFTAG_IMAGEDEPTH};
+        static const uint32_t Shorts[] = {TIFFTAG_BITSPERSAMPLE,TIFFTAG_SAMPLESPERPIXEL,TIFFTAG_COMPRESSION,TIFFTAG_PHOTOMETRIC,
+                                          TIFFTAG_THRESHHOLDING,TIFFTAG_FILLORDER,TIFFTAG_ORIENTATION,TIFFTAG_PLANARCONFIG,
+                                          TIFFTAG_MINSAMPLEVALUE,TIFFTAG_MAXSAMPLEVALUE,TIFFTAG_RESOLUTIONUNIT,TIFFTAG_SAMPLEFORMAT,
+                                          TIFFTAG_YCBCRPOSITIONING,TIFFTAG_PREDICTOR};
+        static const uint32_t Floats[] = {TIFFTAG_XRESOLUTION,TIFFTAG_YRESOLUTION,TIFFTAG_XPOSITION,TIFFTAG_YPOSITION};
+
+        for(uint32_t t : Longs)
+            Copy<uint32_t>(in,out,t);
+
+        for(uint32_t t : Shorts)
+            Copy<uint16_t>(in,out,t);
+
+        for(uint32_t t : Floats)
+            Copy<float>(in,out,t);
+
+        if(TIFFIsTiled(in)) {
+            Copy<uint32_t>(in,out,TIFFTAG_TILEWIDTH);
+            Copy<uint32_t>(in,out,TIFFTAG_TILELENGTH);
+            Copy<uint32_t>(in,out,TIFFTAG_TILEDEPTH);
+        } else {
+            Copy<uint32_t>(in,out,TIFFTAG_ROWSPERSTRIP);
+        }
+
+        Copy<double>(in,out,TIFFTAG_SMINSAMPLEVALUE);
+        Copy<double>(in,out,TIFFTAG_SMAXSAMPLEVALUE);
+        Copy<float *>(in,out,TIFFTAG_REFERENCEBLACKWHITE);
+
+        CopyPair<uint16_t>(in,out,TIFFTAG_PAGENUMBER);
+        CopyPair<uint16_t>(in,out,TIFFTAG_HALFTONEHINTS);
+        CopyPair<uint16_t>(in,out,TIFFTAG_YCBCRSUBSAMPLING);
+
+        uint16_t   extra = 0;
+        uint16_t * types = NULL;
+
+        if(TIFFGetField(in,TIFFTAG_EXTRASAMPLES,&extra,&types)==1)
+            TIFFSetField(out,TIFFTAG_EXTRASAMPLES,(int)extra,types);
+
+        uint16_t * c[3];
+
+        if(TIFFGetField(in,TIFFTAG_COLORMAP,&c[0],&c[1],&c[2])==1)
+            TIFFSetField(out,TIFFTAG_COLORMAP,c[0],c[1],c[2]);
+
+        // One transfer function, or three unless there's a single
+        // colour sample
+
+        uint16_t spp = 1;
+
+        TIFFGetFieldDefaulted(in,TIFFTAG_SAMPLESPERPIXEL,&spp);
+
+        if(spp-extra>1) {
+            if(TIFFGetField(in,TIFFTAG_TRANSFERFUNCTION,&c[0],&c[1],&c[2])==1)
+                TIFFSetField(out,TIFFTAG_TRANSFERFUNCTION,c[0],c[1],c[2]);
+        } else {
+            if(TIFFGetField(in,TIFFTAG_TRANSFERFUNCTION,&c[0])==1)
+                TIFFSetField(out,TIFFTAG_TRANSFERFUNCTION,c[0]);
+        }
+
+        // The ink names are read without their length; it's one
+        // string per ink
+
+        char * inks = NULL;
+
+        if(TIFFGetField(in,TIFFTAG_INKNAMES,&inks)==1 && inks!=NULL) {
+            uint16_t n = spp;
+            size_t   l = 0;
+
+            TIFFGetField(in,TIFFTAG_NUMBEROFINKS,&n);
+
+            for(uint16_t i=0;i<n;i++)
+                l += ::strlen(inks+l)+1;
+
+            TIFFSetField(out,TIFFTAG_INKNAMES,(int)l,inks);
+        }
+
+        uint32_t jn = 0;
+        void   * jt = NULL;
+
+        if(TIFFGetField(in,TIFFTAG_JPEGTABLES,&jn,&jt)==1)
+            TIFFSetField(out,TIFFTAG_JPEGTABLES,jn,jt);
+
+        for(int i=0,n=TIFFGetTagListCount(in);i<n;i++) {
+            uint32_t t = TIFFGetTagListEntry(in,i);
+
+            if(t==TIFFTAG_SUBIFD || (t==TIFFTAG_PHOTOSHOP && !photoshop))
+                continue;
+
+            CopyCustom(in,out,t);
+        }
+
+        return true;
+    }
+
+    bool TiffCopy::copy_data(TIFF * in,TIFF * out) {
+        if(in==NULL || out==NULL)
+            return false;
+
+        bool                tiled = TIFFIsTiled(in);
+        uint32_t            n     = tiled ? TIFFNumberOfTiles(in) : TIFFNumberOfStrips(in);
+        std::vector<Byte_t> b;
+
+        for(uint32_t i=0;i<n;i++) {
+            uint64_t c = TIFFGetStrileByteCount(in,i);
+
+            // Leave sparse strips and tiles sparse
+
+            if(c==0)
+                continue;
+
+            b.resize(c);
+
+            tmsize_t r = tiled ? TIFFReadRawTile(in,i,b.data(),c) : TIFFReadRawStrip(in,i,b.data(),c);
+
+            if(r<0)
+                return false;
+
+            tmsize_t w = tiled ? TIFFWriteRawTile(out,i,b.data(),r) : TIFFWriteRawStrip(out,i,b.data(),r);
+
+            if(w!=r)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool TiffCopy::copy_directory(TIFF * in,TIFF * out,ResourceList * l) {
+        return copy_tags(in,out,l==NULL) && (l==NULL || l->write(out)) && copy_data(in,out);
+    }
+
+    bool TiffCopy::copy(TIFF * in,TIFF * out,const Resources_t & f) {
+        if(in==NULL || out==NULL)
+            return false;
+
+        size_t page = 0;
+
+        do {
+            if(!copy_directory(in,out,f ? f(page) : NULL) || TIFFWriteDirectory(out)!=1)
+                return false;
+            page++;
+        } while(TIFFReadDirectory(in));
+
+        return true;
+    }
+
+    const char * TiffCopy::get_write_mode(uint64_t size) {
+        return size>TiffFormat::ClassicLimit ? "w8" : "w";
+    }
+}
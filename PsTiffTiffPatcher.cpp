@@ -0,0 +1,270 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/TiffPatcher.h>
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff
+{
+    bool TiffPatcher::open(const std::string & path) {
+        close();
+
+        if((_fd = ::open(path.c_str(),O_RDWR|O_CLOEXEC))<0)
+            return false;
+
+        struct stat st;
+
+        if(::fstat(_fd,&st)!=0) {
+            close();
+            return false;
+        }
+
+        _size = st.st_size;
+
+        Byte_t h[16];
+
+        if(_size<TiffFormat::MinHeaderSize) {
+            _st = ParseStatus(ParseStatus::BadTiffHeader,0);
+            return true;
+        }
+
+        read(0,h,TiffFormat::MinHeaderSize);
+
+        size_t n = TiffFormat::get_header_size(h);
+
+        if(n>TiffFormat::MinHeaderSize && _size>=n)
+            read(0,h,n);
+
+        if((_st = _f.read_header(h,std::min<uint64_t>(n,_size),_first)) && _first>=_size)
+            _st = ParseStatus(ParseStatus::BadDirectory,_f.get_first_link());
+
+        return true;
+    }
+
+    void TiffPatcher::close() {
+        if(_fd>=0)
+            ::close(_fd);
+
+        _fd    = -1;
+        _size  = 0;
+        _first = 0;
+        _st    = ParseStatus();
+    }
+
+    void TiffPatcher::read(uint64_t off,void * p,size_t n) {
+        for(size_t l=0;l<n;) {
+            ssize_t r = ::pread(_fd,(Byte_t *)p+l,n-l,off+l);
+
+            if(r<0 && errno==EINTR)
+                continue;
+
+            if(r<=0)
+                throw std::runtime_error(std::string("TiffPatcher: read failed: ")+(r<0 ? ::strerror(errno) : "end of file"));
+
+            l += r;
+        }
+    }
+
+    void TiffPatcher::write(uint64_t off,const void * p,size_t n) {
+        for(size_t l=0;l<n;) {
+            ssize_t r = ::pwrite(_fd,(const Byte_t *)p+l,n-l,off+l);
+
+            if(r<0 && errno==EINTR)
+                continue;
+
+            if(r<=0)
+                throw std::runtime_error(std::string("TiffPatcher: write failed: ")+::strerror(errno));
+
+            l += r;
+        }
+
+        if(off+n>_size)
+            _size = off+n;
+    }
+
+    ParseStatus TiffPatcher::find(size_t page,Directory_t & d) {
+        if(!is_open())
+            return ParseStatus(ParseStatus::BadTiffHeader,0);
+
+        if(!_st)
+            return _st;
+
+        std::set<uint64_t> seen;
+        uint64_t           link = _f.get_first_link();
+        uint64_t           off  = _first;
+        uint64_t           cs   = _f.get_count_size();
+        uint64_t           es   = _f.get_entry_size();
+        uint64_t           ws   = _f.get_word_size();
+
+        for(size_t i=0;;i++) {
+            if(off==0 || i>=TiffWalker::MaxDirectories)
+                return ParseStatus(ParseStatus::BadDirectory,link);
+
+            if(off<_f.get_header_size() || off>_size || _size-off<cs || !seen.insert(off).second)
+                return ParseStatus(ParseStatus::BadDirectory,off);
+
+            Byte_t c[8];
+
+            read(off,c,cs);
+
+            uint64_t n = _f.get_count(c);
+
+            if((_size-off-cs)/es<n || _size-off-cs-n*es<ws)
+                return ParseStatus(ParseStatus::BadDirectory,off);
+
+            if(i==page) {
+                d.link   = link;
+                d.offset = off;
+                d.count  = n;
+                d.entries.resize(n*es+ws);
+
+                read(off+cs,d.entries.data(),d.entries.size());
+
+                return ParseStatus();
+            }
+
+            link = off+cs+n*es;
+            read(link,c,ws);
+            off  = _f.get_word(c);
+        }
+    }
+
+    /** Append p[n] word aligned behind the end of the file; off gets
+        its offset. Fails if a classic TIFF would outgrow 32 bit
+        offsets.
+     */
+
+    ParseStatus TiffPatcher::append(const Byte_t * p,size_t n,uint64_t & off) {
+        uint64_t o = _size + (_size & 1);
+
+        if(o>_f.get_limit() || n>_f.get_limit()-o)
+            return ParseStatus(ParseStatus::BadSize,o);
+
+        if(o>_size) {
+            Byte_t z = 0;
+            write(_size,&z,1);
+        }
+
+        write(o,p,n);
+        off = o;
+
+        return ParseStatus();
+    }
+
+    ParseStatus TiffPatcher::set_tag(size_t page,uint16_t tag,uint16_t type,const Byte_t * p,size_t n) {
+        size_t t = TiffWalker::get_type_size(type);
+
+        if(t==0 || n==0 || n%t!=0 || (!_f.is_big() && n/t>UINT32_MAX))
+            return ParseStatus(ParseStatus::BadSize,0);
+
+        Directory_t d;
+        ParseStatus s = find(page,d);
+
+        if(!s)
+            return s;
+
+        uint64_t es = _f.get_entry_size();
+        uint64_t ws = _f.get_word_size();
+        uint64_t vp = _f.get_value_pos();
+        Byte_t   ne[20];
+        uint64_t po = 0;
+
+        ::memset(ne,0,sizeof(ne));
+
+        _f.put_word(_f.put16(_f.put16(ne,tag),type),n/t);
+
+        if(n<=ws)
+            ::memcpy(ne+vp,p,n);
+
+        for(uint64_t i=0;i<d.count;i++) {
+            const Byte_t * e = d.entries.data()+i*es;
+
+            if(_f.get_tag(e)!=tag)
+                continue;
+
+            uint64_t os = _f.get_value_count(e) * TiffWalker::get_type_size(_f.get_type(e));
+
+            if(n>ws) {
+                if(os>ws && n<=os) {
+                    po = _f.get_word(e+vp);
+                    write(po,p,n);
+                } else if(!(s = append(p,n,po))) {
+                    return s;
+                }
+
+                _f.put_word(ne+vp,po);
+            }
+
+            write(d.offset+_f.get_count_size()+i*es,ne,es);
+
+            return ParseStatus();
+        }
+
+        // No such tag yet: a copy of the directory with the new entry
+        // in order of tags, pointing to the same payloads and the same
+        // next directory
+
+        if(!_f.is_big() && d.count>=UINT16_MAX)
+            return ParseStatus(ParseStatus::BadDirectory,d.offset);
+
+        if(n>ws) {
+            if(!(s = append(p,n,po)))
+                return s;
+
+            _f.put_word(ne+vp,po);
+        }
+
+        uint64_t k = 0;
+
+        while(k<d.count && _f.get_tag(d.entries.data()+k*es)<tag)
+            k++;
+
+        std::vector<Byte_t> nd(_f.get_directory_size(d.count+1));
+        Byte_t            * q = _f.put_count(nd.data(),d.count+1);
+
+        q = std::copy(d.entries.data(),d.entries.data()+k*es,q);
+        q = std::copy(ne,ne+es,q);
+        q = std::copy(d.entries.data()+k*es,d.entries.data()+d.entries.size(),q);
+
+        uint64_t no;
+
+        if(!(s = append(nd.data(),nd.size(),no)))
+            return s;
+
+        Byte_t l[8];
+
+        _f.put_word(l,no);
+        write(d.link,l,ws);
+
+        if(d.link==_f.get_first_link())
+            _first = no;
+
+        return ParseStatus();
+    }
+}
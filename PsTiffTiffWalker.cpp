@@ -0,0 +1,117 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/TiffWalker.h>
+
+namespace PsTiff
+{
+    TiffWalker::TiffWalker(const Byte_t * p,size_t n) : _p(p),_n(n),_first(0) {
+        _st = _f.read_header(p,n,_first);
+
+        if(_st && _first>=n)
+            _st = ParseStatus(ParseStatus::BadDirectory,_f.get_first_link());
+    }
+
+    size_t TiffWalker::get_type_size(uint16_t t) {
+        switch(t) {
+        case  1:         // BYTE
+        case  2:         // ASCII
+        case  6:         // SBYTE
+        case  7:         // UNDEFINED
+            return 1;
+        case  3:         // SHORT
+        case  8:         // SSHORT
+            return 2;
+        case  4:         // LONG
+        case  9:         // SLONG
+        case 11:         // FLOAT
+        case 13:         // IFD
+            return 4;
+        case  5:         // RATIONAL
+        case 10:         // SRATIONAL
+        case 12:         // DOUBLE
+        case 16:         // LONG8
+        case 17:         // SLONG8
+        case 18:         // IFD8
+            return 8;
+        }
+        return 0;
+    }
+
+    ParseStatus TiffWalker::read_tag(const Byte_t * e,Tag_t & t) const {
+        t.tag   = _f.get_tag(e);
+        t.type  = _f.get_type(e);
+        t.count = _f.get_value_count(e);
+        t.entry = e - _p;
+
+        uint64_t s = t.count * get_type_size(t.type);
+
+        if(get_type_size(t.type)==0 || s/get_type_size(t.type)!=t.count)
+            return ParseStatus(ParseStatus::BadDirectory,t.entry);
+
+        t.offset = s<=_f.get_word_size() ? t.entry+_f.get_value_pos() : _f.get_word(e+_f.get_value_pos());
+
+        if(t.offset>_n || s>_n-t.offset)
+            return ParseStatus(ParseStatus::BadDirectory,t.entry);
+
+        t.data = Span_t(_p+t.offset,(size_t)s);
+
+        return ParseStatus();
+    }
+
+    ParseStatus TiffWalker::read_directory(uint64_t off,Directory_t & d) const {
+        uint64_t cs = _f.get_count_size();
+        uint64_t es = _f.get_entry_size();
+
+        if(off<_f.get_header_size() || off>_n || _n-off<cs)
+            return ParseStatus(ParseStatus::BadDirectory,off);
+
+        const Byte_t * p = _p + off;
+        uint64_t       n = _f.get_count(p);
+
+        if((_n-off-cs)/es<n || (_n-off-cs-n*es)<_f.get_word_size())
+            return ParseStatus(ParseStatus::BadDirectory,off);
+
+        d.offset = off;
+        d.count  = n;
+        d.next   = _f.get_word(p+cs+n*es);
+
+        for(uint64_t i=0;i<n;i++) {
+            const Byte_t * e   = p+cs+i*es;
+            uint16_t       tag = _f.get_tag(e);
+            Tag_t        * t   = NULL;
+
+            switch(tag) {
+            case TagPhotoshop:    t = &d.photoshop; break;
+            case TagXmp:          t = &d.xmp;       break;
+            case TagPhotoshopDdb: t = &d.ddb;       break;
+            default:
+                continue;
+            }
+
+            ParseStatus s = read_tag(e,*t);
+
+            if(!s)
+                return s;
+        }
+
+        return ParseStatus();
+    }
+}
@@ -0,0 +1,170 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#include <pstiff/Types.h>
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PSTIFF_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace PsTiff
+{
+    namespace {
+
+        /** Byte swapping is its own inverse, so decoding and encoding
+            share one kernel per width working on raw bytes.
+         */
+
+        typedef void (*Swap_t)(void * d,const void * s,size_t n);
+
+        void swap16_scalar(void * d,const void * s,size_t n) {
+            const Byte_t * p = (const Byte_t *)s;
+            Byte_t       * q = (Byte_t *)d;
+            for(size_t i=0;i<n;i++,p+=2,q+=2) {
+                uint16_t v;
+                ::memcpy(&v,p,sizeof(v));
+                v = bswap16(v);
+                ::memcpy(q,&v,sizeof(v));
+            }
+        }
+
+        void swap32_scalar(void * d,const void * s,size_t n) {
+            const Byte_t * p = (const Byte_t *)s;
+            Byte_t       * q = (Byte_t *)d;
+            for(size_t i=0;i<n;i++,p+=4,q+=4) {
+                uint32_t v;
+                ::memcpy(&v,p,sizeof(v));
+                v = bswap32(v);
+                ::memcpy(q,&v,sizeof(v));
+            }
+        }
+
+#ifdef PSTIFF_X86_KERNELS
+        __attribute__((target("ssse3")))
+        void swap_ssse3(void * d,const void * s,size_t n,__m128i m,size_t w) {
+            const Byte_t * p = (const Byte_t *)s;
+            Byte_t       * q = (Byte_t *)d;
+            size_t         b = n * w;
+            size_t         i = 0;
+
+            for(;i+16<=b;i+=16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+                _mm_storeu_si128((__m128i *)(q+i),_mm_shuffle_epi8(v,m));
+            }
+
+            if(w==2)
+                swap16_scalar(q+i,p+i,(b-i)/2);
+            else
+                swap32_scalar(q+i,p+i,(b-i)/4);
+        }
+
+        __attribute__((target("ssse3")))
+        void swap16_ssse3(void * d,const void * s,size_t n) {
+            swap_ssse3(d,s,n,_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14),2);
+        }
+
+        __attribute__((target("ssse3")))
+        void swap32_ssse3(void * d,const void * s,size_t n) {
+            swap_ssse3(d,s,n,_mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12),4);
+        }
+
+        __attribute__((target("avx2")))
+        void swap_avx2(void * d,const void * s,size_t n,__m256i m,size_t w) {
+            const Byte_t * p = (const Byte_t *)s;
+            Byte_t       * q = (Byte_t *)d;
+            size_t         b = n * w;
+            size_t         i = 0;
+
+            for(;i+32<=b;i+=32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+                _mm256_storeu_si256((__m256i *)(q+i),_mm256_shuffle_epi8(v,m));
+            }
+
+            if(w==2)
+                swap16_scalar(q+i,p+i,(b-i)/2);
+            else
+                swap32_scalar(q+i,p+i,(b-i)/4);
+        }
+
+        __attribute__((target("avx2")))
+        void swap16_avx2(void * d,const void * s,size_t n) {
+            swap_avx2(d,s,n,_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                             1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14),2);
+        }
+
+        __attribute__((target("avx2")))
+        void swap32_avx2(void * d,const void * s,size_t n) {
+            swap_avx2(d,s,n,_mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                                             3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12),4);
+        }
+#endif
+
+        struct Kernels_t {
+            Swap_t       swap16;
+            Swap_t       swap32;
+            const char * name;
+        };
+
+        /** On big endian hosts bswap16/32 are no-ops and the scalar
+            kernels boil down to a copy.
+         */
+
+        Kernels_t select() {
+#ifdef PSTIFF_X86_KERNELS
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2"))
+                return Kernels_t{swap16_avx2,swap32_avx2,"avx2"};
+            if(__builtin_cpu_supports("ssse3"))
+                return Kernels_t{swap16_ssse3,swap32_ssse3,"ssse3"};
+#endif
+            return Kernels_t{swap16_scalar,swap32_scalar,"scalar"};
+        }
+
+        const Kernels_t & kernels() {
+            static const Kernels_t k = select();
+            return k;
+        }
+    }
+
+    void decode16(uint16_t * d,const Byte_t * s,size_t n) {
+        kernels().swap16(d,s,n);
+    }
+
+    void decode32(uint32_t * d,const Byte_t * s,size_t n) {
+        kernels().swap32(d,s,n);
+    }
+
+    Byte_t * encode16(Byte_t * d,const uint16_t * s,size_t n) {
+        kernels().swap16(d,s,n);
+        return d + n * sizeof(uint16_t);
+    }
+
+    Byte_t * encode32(Byte_t * d,const uint32_t * s,size_t n) {
+        kernels().swap32(d,s,n);
+        return d + n * sizeof(uint32_t);
+    }
+
+    const char * get_kernel_name() {
+        return kernels().name;
+    }
+}
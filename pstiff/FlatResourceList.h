@@ -0,0 +1,267 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_FLATRESOURCELIST_H
+#define PSTIFF_FLATRESOURCELIST_H
+
+#include "tiffio.h"
+#include <pstiff/Resource.h>
+#include <pstiff/ResourceDecoder.h>
+
+#include <iterator>
+#include <memory_resource>
+#include <variant>
+#include <vector>
+
+namespace PsTiff {
+
+    /**
+     * @brief The FlatResourceList class
+     *
+     * Alternative storage for the Resources of a TIFFTAG_PHOTOSHOP tag.
+     * Instead of one heap object per Resource all of them live side by
+     * side in a single vector of variants over the typed Resources of
+     * this library. Iterating hands out const Resource * just like
+     * the entries of ResourceList, so
+     *
+     *    for(i=l.begin();i!=l.end();i++) (*i)->get_id();
+     *
+     * works for both of them.
+     *
+     * Only the typed Resources known here are supported. read()
+     * throws std::runtime_error if the decoder has anything else
+     * registered for a selected Id; deselect it or use ResourceList.
+     */
+
+    class FlatResourceList {
+    public:
+        typedef std::variant<Resource,
+                             SpotColorResource,
+                             AlphaNamesResource,
+                             UnicodeAlphaNamesResource,
+                             AlphaIdentifiersResource,
+                             IdSeedNumberResource,
+                             VersionInfoResource,
+                             DisplayInfoResource> entry_t;
+
+    private:
+        typedef std::pmr::vector<entry_t> vector_t;
+
+        static const Resource * to_resource(const entry_t & e) {
+            return std::visit([](const auto & r) -> const Resource * { return &r; },e);
+        }
+
+    public:
+        class const_iterator {
+        public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef const Resource *                value_type;
+            typedef std::ptrdiff_t                  difference_type;
+            typedef const value_type *              pointer;
+            typedef value_type                      reference;
+
+            const_iterator() {
+            }
+
+            explicit
+            const_iterator(vector_t::const_iterator i) : _i(i) {
+            }
+
+            reference operator*() const {
+                return to_resource(*_i);
+            }
+
+            const_iterator & operator++() {
+                ++_i;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator i(*this);
+                ++_i;
+                return i;
+            }
+
+            const_iterator & operator--() {
+                --_i;
+                return *this;
+            }
+
+            const_iterator operator--(int) {
+                const_iterator i(*this);
+                --_i;
+                return i;
+            }
+
+            const_iterator & operator+=(difference_type n) {
+                _i += n;
+                return *this;
+            }
+
+            const_iterator operator+(difference_type n) const {
+                return const_iterator(_i+n);
+            }
+
+            difference_type operator-(const const_iterator & i) const {
+                return _i - i._i;
+            }
+
+            reference operator[](difference_type n) const {
+                return to_resource(_i[n]);
+            }
+
+            bool operator==(const const_iterator & i) const {
+                return _i==i._i;
+            }
+
+            bool operator!=(const const_iterator & i) const {
+                return _i!=i._i;
+            }
+
+            bool operator<(const const_iterator & i) const {
+                return _i<i._i;
+            }
+
+        private:
+            vector_t::const_iterator _i;
+        };
+
+        /** All entries and everything read() allocates for them come
+            from mr.
+         */
+
+        explicit
+        FlatResourceList(Memory_t * mr=std::pmr::get_default_resource()) : _raw(mr),_v(mr) {
+        }
+
+        Memory_t * get_memory_resource() const {
+            return _v.get_allocator().resource();
+        }
+
+        size_t size() const {
+            return _v.size();
+        }
+
+        const Resource & operator[](size_t idx) const {
+            return *to_resource(_v.at(idx));
+        }
+
+        /** The variant itself, e.g. for std::visit or std::get_if
+         */
+
+        const entry_t & get_entry(size_t idx) const {
+            return _v.at(idx);
+        }
+
+        void clear() {
+            _v.clear();
+        }
+
+        void reserve(size_t n) {
+            _v.reserve(n);
+        }
+
+        /** Exact number of bytes of the serialized list
+         */
+
+        int get_size() const {
+            int s=0;
+            for(vector_t::const_iterator i=_v.begin();i!=_v.end();i++) {
+                s += to_resource(*i)->get_size();
+            }
+            return s;
+        }
+
+        /** Serialize all Resources into p which has to provide
+            get_size() bytes. Returns the first byte behind the list.
+         */
+
+        Byte_t * encode(Byte_t * p) const {
+            for(vector_t::const_iterator i=_v.begin();i!=_v.end();i++) {
+                p = to_resource(*i)->encode(p);
+            }
+            return p;
+        }
+
+        /** The serialized list. The buffer is owned by the list and
+            gets reused by the next call.
+         */
+
+        const Byte_t * get_raw() {
+            _raw.resize(get_size());
+            encode(_raw.data());
+            return _raw.data();
+        }
+
+        const_iterator begin() const  {
+            return const_iterator(_v.begin());
+        }
+
+        const_iterator end() const  {
+            return const_iterator(_v.end());
+        }
+
+        /** Read the Resources of the current directory of in
+         */
+
+        bool read(TIFF * in,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Decode the Photoshop resource blob p[n]. The blob gets
+            copied once into a buffer shared by all Resources.
+         */
+
+        void read(const Byte_t * p,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Decode the blob b[n] without copying it. Blocks the decoder
+            d has not selected are skipped.
+         */
+
+        void read(const Buffer_t & b,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Non throwing versions of read(). Malformed blocks are
+            handled according to pol and recorded in diag; the blocks
+            read so far stay in the list. Returns the first error.
+            An unsupported decoder still throws, see above.
+         */
+
+        ParseStatus try_read(const Byte_t * p,size_t n,const ResourceDecoder & d=ResourceDecoder::Default(),
+                             ParsePolicy_t pol=Strict,ParseDiagnostics * diag=NULL);
+
+        ParseStatus try_read(const Buffer_t & b,size_t n,const ResourceDecoder & d=ResourceDecoder::Default(),
+                             ParsePolicy_t pol=Strict,ParseDiagnostics * diag=NULL);
+
+    private:
+        /** Throw if d decodes a selected Id into something entry_t
+            has no alternative for
+         */
+
+        static void check(const ResourceDecoder & d);
+
+        /** Append the selected and validated block v
+         */
+
+        void add(const ResourceView & v,const ResourceDecoder & d);
+
+        std::pmr::vector<Byte_t> _raw;  //< serialized list as handed out by get_raw()
+        vector_t                 _v;
+    };
+}
+
+#endif // PSTIFF_FLATRESOURCELIST_H
@@ -0,0 +1,122 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_JPEGREADER_H
+#define PSTIFF_JPEGREADER_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+
+    /**
+     * @brief The JpegReader class
+     *
+     * Collects the Photoshop resources of a JPEG file. Photoshop keeps
+     * them in APP13 segments starting with "Photoshop 3.0\0"; as a
+     * segment holds at most 64K a bigger list gets split across
+     * several, and the payloads have to be joined in order.
+     *
+     * The segments get followed by their length fields from the SOI
+     * marker up to the first SOS marker, where the entropy coded data
+     * starts. Only the marker headers and the APP13 payloads are read.
+     */
+
+    class JpegReader {
+    public:
+        /** A piece of the resources: size bytes at offset
+         */
+
+        struct Part_t {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        typedef std::vector<Part_t> Parts_t;
+
+        JpegReader() : _fd(-1),_size(0) {
+        }
+
+        explicit
+        JpegReader(const std::string & path) : JpegReader() {
+            open(path);
+        }
+
+        JpegReader(const JpegReader &) = delete;
+        JpegReader & operator=(const JpegReader &) = delete;
+
+        ~JpegReader() {
+            close();
+        }
+
+        /** Open path and find its Photoshop segments. Returns false if
+            the file can't be opened; format errors are left to
+            get_status().
+         */
+
+        bool open(const std::string & path);
+
+        void close();
+
+        bool is_open() const {
+            return _fd>=0;
+        }
+
+        const ParseStatus & get_status() const {
+            return _st;
+        }
+
+        /** Where the pieces of the resources are, in order
+         */
+
+        const Parts_t & get_parts() const {
+            return _parts;
+        }
+
+        /** Size of the joined resources
+         */
+
+        uint64_t get_resources_size() const;
+
+        /** Read and join the resources into b, a buffer of
+            get_resources_size() bytes allocated from mr
+         */
+
+        ParseStatus read_resources(Buffer_t & b,Memory_t * mr=std::pmr::get_default_resource());
+
+        /** Find the Photoshop segments of the JPEG file kept in p[n]
+         */
+
+        static ParseStatus find_resources(const Byte_t * p,size_t n,Parts_t & parts);
+
+    private:
+        bool read(uint64_t off,void * p,size_t n);
+
+        int         _fd;
+        uint64_t    _size;
+        Parts_t     _parts;
+        ParseStatus _st;
+    };
+}
+
+#endif // PSTIFF_JPEGREADER_H
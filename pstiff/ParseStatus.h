@@ -0,0 +1,196 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_PARSESTATUS_H
+#define PSTIFF_PARSESTATUS_H
+
+#include <stdexcept>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PsTiff {
+
+    /**
+     * @brief The ParseStatus class
+     *
+     * Outcome of a non throwing parse: an error code plus the offset
+     * of the offending byte. Nothing gets allocated, the message is
+     * a static string.
+     */
+
+    class ParseStatus {
+    public:
+        typedef enum {
+            Ok = 0,
+            BadSignature,    //< block does not start with '8BIM'
+            TruncatedHeader, //< blob ends within the block header
+            TruncatedData,   //< block claims more data than there is
+            BadSize,         //< data size does not fit the resource type
+            BadContent,      //< data inconsistent with itself
+            WrongId,         //< typed resource handed a block of another type
+            BadTiffHeader,   //< not a TIFF or BigTIFF header
+            BadDirectory,    //< TIFF directory or tag outside the file or looping
+            BadPsdHeader,    //< not a PSD or PSB header
+            BadSection,      //< PSD section outside the file
+            BadJpegHeader,   //< not a JPEG file
+            BadSegment       //< JPEG segment outside the file or without marker
+        } Code_t;
+
+        ParseStatus() : _code(Ok),_off(0) {
+        }
+
+        ParseStatus(Code_t c,size_t off) : _code(c),_off(off) {
+        }
+
+        Code_t get_code() const {
+            return _code;
+        }
+
+        /** Offset of the error relative to whatever has been parsed,
+            e.g. the start of a block or blob.
+         */
+
+        size_t get_offset() const {
+            return _off;
+        }
+
+        bool ok() const {
+            return _code==Ok;
+        }
+
+        explicit operator bool() const {
+            return ok();
+        }
+
+        /** Same status with the offset moved by o
+         */
+
+        ParseStatus shift(size_t o) const {
+            return ok() ? *this : ParseStatus(_code,_off+o);
+        }
+
+        const char * get_message() const {
+            return to_string(_code);
+        }
+
+        static const char * to_string(Code_t c) {
+            switch(c) {
+            case Ok:              return "ok";
+            case BadSignature:    return "expected '8BIM' signature";
+            case TruncatedHeader: return "truncated resource block header";
+            case TruncatedData:   return "resource block data exceeds blob";
+            case BadSize:         return "illegal data size for resource";
+            case BadContent:      return "malformed resource data";
+            case WrongId:         return "unexpected resource id";
+            case BadTiffHeader:   return "not a TIFF file";
+            case BadDirectory:    return "malformed TIFF directory";
+            case BadPsdHeader:    return "not a PSD or PSB file";
+            case BadSection:      return "malformed PSD section";
+            case BadJpegHeader:   return "not a JPEG file";
+            case BadSegment:      return "malformed JPEG segment";
+            }
+            return "unknown error";
+        }
+
+        /** The throwing API: turn a failed status into an exception
+         */
+
+        void check() const {
+            if(!ok())
+                throw std::runtime_error(std::string(get_message()) + " at offset " + std::to_string(_off));
+        }
+
+    private:
+        Code_t _code;
+        size_t _off;
+    };
+
+    /**
+     * @brief The ParseDiagnostics class
+     *
+     * Fixed capacity record of the errors skipped while parsing with
+     * the Resync policy. Errors beyond the capacity are only counted.
+     */
+
+    class ParseDiagnostics {
+    public:
+        static const size_t Capacity = 32;
+
+        ParseDiagnostics() : _n(0),_dropped(0) {
+        }
+
+        void add(const ParseStatus & s) noexcept {
+            if(_n<Capacity)
+                _s[_n++] = s;
+            else
+                _dropped++;
+        }
+
+        size_t size() const {
+            return _n;
+        }
+
+        bool empty() const {
+            return _n==0 && _dropped==0;
+        }
+
+        /** Number of errors which did not fit
+         */
+
+        size_t get_dropped() const {
+            return _dropped;
+        }
+
+        const ParseStatus & operator[](size_t i) const {
+            return _s[i];
+        }
+
+        const ParseStatus * begin() const {
+            return _s;
+        }
+
+        const ParseStatus * end() const {
+            return _s+_n;
+        }
+
+        void clear() {
+            _n       = 0;
+            _dropped = 0;
+        }
+
+    private:
+        ParseStatus _s[Capacity];
+        size_t      _n;
+        size_t      _dropped;
+    };
+
+    /** What to do with a malformed block: Strict stops at the first
+        one, Resync records it, searches the next '8BIM' and goes on.
+     */
+
+    typedef enum {
+        Strict,
+        Resync
+    } ParsePolicy_t;
+}
+
+#endif // PSTIFF_PARSESTATUS_H
@@ -0,0 +1,144 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_PSDREADER_H
+#define PSTIFF_PSDREADER_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+
+#include <string>
+
+namespace PsTiff {
+
+    /**
+     * @brief The PsdReader class
+     *
+     * Finds the Image Resources section of a native Photoshop file
+     * (PSD, or PSB for the large document format). It's the same
+     * sequence of '8BIM' blocks a TIFF keeps in its Photoshop tag. A
+     * PSD file starts with
+     *
+     *   header           26 bytes
+     *   color mode data  4 byte length + data
+     *   image resources  4 byte length + blocks
+     *   layers and masks, image data
+     *
+     * all big endian. Only the header and the two lengths get read to
+     * find the section, and then the section itself. Layer and image
+     * data, which make up almost all of the file, are never read.
+     */
+
+    class PsdReader {
+    public:
+        static const size_t HeaderSize = 26;
+
+        struct Header_t {
+            Header_t() : version(0),channels(0),height(0),width(0),depth(0),mode(0) {
+            }
+
+            uint16_t version;   //< 1 for PSD, 2 for PSB
+            uint16_t channels;
+            uint32_t height;
+            uint32_t width;
+            uint16_t depth;     //< bits per channel
+            uint16_t mode;      //< color mode, e.g. 4 for CMYK, 7 for multichannel
+        };
+
+        PsdReader() : _fd(-1),_size(0),_offset(0),_length(0) {
+        }
+
+        explicit
+        PsdReader(const std::string & path) : PsdReader() {
+            open(path);
+        }
+
+        PsdReader(const PsdReader &) = delete;
+        PsdReader & operator=(const PsdReader &) = delete;
+
+        ~PsdReader() {
+            close();
+        }
+
+        /** Open path and locate its Image Resources section. Returns
+            false if the file can't be opened; format errors are left
+            to get_status().
+         */
+
+        bool open(const std::string & path);
+
+        void close();
+
+        bool is_open() const {
+            return _fd>=0;
+        }
+
+        const ParseStatus & get_status() const {
+            return _st;
+        }
+
+        const Header_t & get_header() const {
+            return _h;
+        }
+
+        bool is_psb() const {
+            return _h.version==2;
+        }
+
+        /** File offset and length of the blocks of the Image Resources
+            section, without the length field in front of them
+         */
+
+        uint64_t get_resources_offset() const {
+            return _offset;
+        }
+
+        uint64_t get_resources_size() const {
+            return _length;
+        }
+
+        /** Read the Image Resources section into b, a buffer of
+            get_resources_size() bytes allocated from mr
+         */
+
+        ParseStatus read_resources(Buffer_t & b,Memory_t * mr=std::pmr::get_default_resource());
+
+        /** Locate the Image Resources section of the PSD file kept in
+            p[n]; off and len get its position like
+            get_resources_offset() and get_resources_size().
+         */
+
+        static ParseStatus find_resources(const Byte_t * p,size_t n,Header_t & h,uint64_t & off,uint64_t & len);
+
+    private:
+        static ParseStatus read_header(const Byte_t * p,Header_t & h);
+
+        bool read(uint64_t off,void * p,size_t n);
+
+        int         _fd;
+        uint64_t    _size;
+        Header_t    _h;
+        uint64_t    _offset;
+        uint64_t    _length;
+        ParseStatus _st;
+    };
+}
+
+#endif // PSTIFF_PSDREADER_H
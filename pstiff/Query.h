@@ -0,0 +1,125 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_QUERY_H
+#define PSTIFF_QUERY_H
+
+#include <pstiff/ResourceDecoder.h>
+#include <pstiff/ResourceList.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+
+    /**
+     * @brief The Query class
+     *
+     * A condition on the resources of a blob or a ResourceList,
+     * compiled once into a tree of predicates:
+     *
+     *   AlternateSpotColors.count > 4
+     *   UnicodeAlphaNames.name contains 'PANTONE'
+     *   VersionInfo and not VersionInfo.writer contains 'CS3'
+     *   1039.size >= 100000 or (DisplayInfo.opacity < 100)
+     *
+     * Resources are named as ResourceId has them; those it has no
+     * name for, like the ICC profile, go by their id. A resource on
+     * its own asks whether there is one. Any resource has a size,
+     * the number of bytes of its data; the typed ones have fields of
+     * their own:
+     *
+     *   AlternateSpotColors  count id space
+     *   AlphaNames           count name
+     *   UnicodeAlphaNames    count name
+     *   AlphaIdentifiers     count id
+     *   IdSeedNumber         seed
+     *   VersionInfo          version merged reader writer
+     *   DisplayInfo          count space opacity kind
+     *
+     * Comparisons are = != < <= > >= and contains for text; a field
+     * holding several values, or a resource found more than once,
+     * matches if any of them does. Conditions combine with and, or,
+     * not and parentheses.
+     *
+     * Only the resources a query names get decoded, each one at most
+     * once and not before a predicate needs it; size and existence
+     * need no more than the validator. and and or stop as soon as
+     * the result is known, so the resources on their other side stay
+     * untouched.
+     */
+
+    class Query {
+    public:
+        /** Compile text. Throws std::runtime_error telling where it
+            went wrong on a syntax error or an unknown resource or
+            field.
+         */
+
+        explicit
+        Query(const std::string & text);
+
+        ~Query();
+
+        Query(const Query &) = delete;
+        Query & operator=(const Query &) = delete;
+
+        const std::string & get_text() const {
+            return _text;
+        }
+
+        /** The resources the query looks at
+         */
+
+        const std::vector<ResourceId::Enum_t> & get_ids() const {
+            return _ids;
+        }
+
+        /** Whether the query only needs what dec decodes into typed
+            resources and the sizes of those
+         */
+
+        bool is_typed(const ResourceDecoder & dec=ResourceDecoder::Default()) const;
+
+        /** Evaluate on the resource blob p[n]. Malformed blocks and
+            blocks failing their validator count as missing.
+         */
+
+        bool match(const Byte_t * p,size_t n,const ResourceDecoder & dec=ResourceDecoder::Default()) const;
+
+        /** Evaluate on the resources of l
+         */
+
+        bool match(const ResourceList & l) const;
+
+        struct Ref_t;
+        struct Node_t;
+        class  Source_t;
+
+    private:
+        std::string                     _text;
+        std::vector<Ref_t>              _refs;
+        std::unique_ptr<Node_t>         _root;
+        std::vector<ResourceId::Enum_t> _ids;
+    };
+}
+
+#endif // PSTIFF_QUERY_H
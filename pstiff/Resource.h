@@ -22,10 +22,15 @@
 #define PSTIFF_RESOURCE_H
 
 #include "pstiff/ResourceId.h"
+#include "pstiff/ResourceView.h"
 #include "pstiff/io/hex_dump.h"
+#include "pstiff/io/emitter.h"
 #include "pstiff/tools/strings.h"
+#include "pstiff/tools/small_vector.h"
 
 #include <vector>
+#include <memory_resource>
+#include <string_view>
 #include <iostream>
 #include <algorithm>
 
@@ -47,6 +52,11 @@ namespace PsTiff
        A sequence starting with '8BIM'<ID><M>string[M]<N>data[N]
        <ID> defines the concrete type of data held in the Resource.
        These types are defined by subclasses of Resource.
+
+       Everything a Resource allocates (the name of built Resources,
+       its tables and a re-encoded blob) comes from the memory resource
+       passed in on construction. As with the std::pmr containers
+       copies allocate from the default resource, moves keep it.
      */
 
     class Resource {
@@ -56,44 +66,84 @@ namespace PsTiff
         /** Create a new empty resource.
          */
 
-        Resource(const std::string & n,ResourceId::Enum_t e) : _pstd(NULL),_pdyn(NULL),_name(n),_size(0),_id(-1) {
+        Resource(std::string_view n,ResourceId::Enum_t e,Memory_t * mr=std::pmr::get_default_resource())
+            : _raw(NULL),_size(0),_doff(0),_dirty(false),_id(-1),_name(n,mr) {
             _id=ResourceId::to_range(e).from;
         }
 
         /** Construct from an existing Photoshop TIFF resource blob.
          */
 
-        Resource(const Byte_t * p) : _pstd(p),_pdyn(NULL),_size(0),_id(0) {
-            if(p!=NULL)   {
-                if(std::string((char*)p,4)!="8BIM")
-                    throw std::runtime_error("expected '8BIM' tag found '"+std::string((char*)p,4)+"'");
+        Resource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource())
+            : _raw(NULL),_size(0),_doff(0),_dirty(false),_id(0),_name(mr) {
+            if(p!=NULL)
+                assign(ResourceView(p));
+        }
+
+        /** Construct from a block already located by ResourceBlocks.
+            The header is not parsed again.
+         */
 
-                _id   = ((uint16_t) *(p+4) << 8 | *(p+5));
-                _name = std::string((char*)p+7,(int)*(p+6));
-                p    += _name.length() & 0x1 != 0x0 ? 7 + _name.length() : 8 + _name.length();
-                _size = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3] << 0;
-            }
+        Resource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource())
+            : _raw(NULL),_size(0),_doff(0),_dirty(false),_id(0),_name(mr) {
+            if(v.get_raw()!=NULL)
+                assign(v);
         }
 
+        /** Copies share the (immutable) blob, modifying a copy
+            makes it encode a blob of its own.
+         */
+
+        Resource(const Resource &) = default;
+        Resource(Resource &&) noexcept = default;
+
+        Resource & operator=(const Resource &) = default;
+        Resource & operator=(Resource &&) = default;
+
+        virtual
         ~Resource() {
-            delete _pdyn;
         }
 
+        /** Polymorphic copy
+         */
+
+        virtual
+        Resource * clone() const {
+            return new Resource(*this);
+        }
+
+        /** Keep the buffer b the blob of this Resource points into
+            alive as long as this Resource or any copy of it lives.
+         */
+
+        void keep_alive(const Buffer_t & b) {
+            if(!_dirty)
+                _buf = b;
+        }
+
+
+        Memory_t * get_memory_resource() const {
+            return _name.get_allocator().resource();
+        }
 
         const Id_t & get_id() const  {
             return _id;
         }
 
         uint32_t get_size()  const {
-            const Byte_t *p = _pstd==NULL ? _pdyn : _pstd;
-
-            if(p!=NULL)
-                return 4 + sizeof(uint16_t) + (_name.length() & 0x1 ? _name.length()+1 : _name.length() + 2  ) + sizeof(uint32_t) + ( (get_data_size() & 0x1) == 0 ? get_data_size() : get_data_size()+1);
+            if(_dirty || _raw!=NULL)
+                return ResourceView::get_header_size(get_name().length()) + ( (get_data_size() & 0x1) == 0 ? get_data_size() : get_data_size()+1);
 
             return 0;
         }
 
-        const std::string & get_name () const {
+        /** The name. Unless the resource has been built from scratch
+            it points right into the blob and is never copied.
+         */
+
+        std::string_view get_name () const {
+            if(_raw!=NULL)
+                return std::string_view((const char *)_raw + 7,_raw[6]);
             return _name;
         }
 
@@ -101,18 +151,50 @@ namespace PsTiff
         const Byte_t *  get_data() const {
             const Byte_t *p = get_raw();
             if( p != NULL) {
-                return p+4+sizeof(uint16_t)+(_name.length() & 0x1 ? _name.length()+1 : _name.length() + 2) + sizeof(uint32_t);
+                return p+_doff;
             }
             return NULL;
         }
 
+        /** The binary blob. Resources modified since they have been
+            read or built get encoded here, once, on first demand.
+            Doing so is not thread safe for the same instance.
+         */
+
         const Byte_t * get_raw() const {
-            return _pstd!=NULL ? _pstd : _pdyn;
+            if(_dirty)
+                materialize();
+            return _raw;
         }
 
-        virtual
         uint32_t get_data_size() const {
-            return _size;
+            return _dirty ? get_encoded_size() : _size;
+        }
+
+        /** Serialize the whole block ('8BIM' header, data and padding)
+            into p which has to provide get_size() bytes. Returns the
+            first byte behind the block.
+         */
+
+        Byte_t * encode(Byte_t * p) const {
+            if(!_dirty && get_raw()==NULL)
+                return p;
+
+            uint32_t s = get_data_size();
+
+            p = encode_header(p);
+
+            if(_dirty) {
+                p = encode_data(p);
+            } else {
+                ::memcpy(p,get_data(),s);
+                p += s;
+            }
+
+            if(s & 0x1)
+                *p++ = 0;
+
+            return p;
         }
 
         /** Generate a string representation of the Resource
@@ -127,45 +209,116 @@ namespace PsTiff
             return ss.str();
         }
 
+        /** Write the typed content as fields of the current object
+            of e. A plain Resource has none; its data is left to the
+            caller.
+         */
+
+        virtual
+        void emit(IO::Emitter &) const {
+        }
+
     protected:
 
-        /** Rebuild the binary blob representation of the Resource.
-         *  Here we expect the pure type specific data and will add
-         *  the '8BIM'<ID><M>name[M] part.
+        /** The block this Resource has been read from; only valid for
+            Resources which have not been built or modified.
          */
 
-        void rebuild(const Byte_t * p,uint32_t s) {
-            _pstd = NULL;
-            delete _pdyn;
-            int so= s + 4 + sizeof(uint16_t) + (_name.length() & 0x1 ? _name.length()+1 : _name.length()+2+sizeof(uint32_t));
+        ResourceView get_view() const {
+            return ResourceView(_raw,get_id().to_int(),_doff,_size);
+        }
+
+        /** Failed status for the validate() functions of subclasses
+            with o counted from the start of the data of v.
+         */
 
-            Byte_t *pp = _pdyn = new Byte_t[so];
+        static ParseStatus fail(ParseStatus::Code_t c,const ResourceView & v,size_t o=0) noexcept {
+            return ParseStatus(c,v.get_data_offset()+o);
+        }
+
+        static ParseStatus wrong_id() noexcept {
+            return ParseStatus(ParseStatus::WrongId,4);
+        }
 
-            ::memset(pp,0,so);
-            ::strncpy((char*)pp,"8BIM",4);
+        /** Mark the content as modified. The blob gets encoded
+            from the content the next time it is needed.
+         */
 
-            from16(  pp + 4,get_id().to_range().from);
-            fromstr( pp + 6,_name);
-            pp   += _name.length() & 0x1 != 0x0 ? 7 + _name.length() : 8 + _name.length();
-            from32(  pp, s);
+        void touch() {
+            _dirty = true;
+        }
 
-            pp+=sizeof(uint32_t);
+        /** Number of bytes encode_data() is going to write
+         */
 
-            memcpy(pp,p,s);
-            _size=s;
+        virtual
+        uint32_t get_encoded_size() const {
+            return _size;
+        }
+
+        /** Write the pure type specific data (get_encoded_size() bytes)
+            to p and return the first byte behind it. Only called for
+            modified resources; subclasses calling touch() have to
+            override this together with get_encoded_size().
+         */
+
+        virtual
+        Byte_t * encode_data(Byte_t * p) const {
+            ::memcpy(p,get_data(),_size);
+            return p+_size;
         }
 
     private:
-        const Byte_t    * _pstd;    //< Static Data pointer as read by the TIFFLib
-        Byte_t          * _pdyn;    //< Dynamic Data pointer for later manipulation
-        uint32_t          _size;
+        /** '8BIM'<ID><M>name[M]<N>
+         */
+
+        Byte_t * encode_header(Byte_t * p) const {
+            ::memcpy(p,"8BIM",4);
+            p = from16(p+4,get_id().to_int());
+            std::string_view n = get_name();
+            p = fromstr(p,n);
+            if((n.length() & 0x1)==0)
+                *p++ = 0;
+            return from32(p,get_data_size());
+        }
+
+        /** Encode the modified content into a fresh blob
+         */
+
+        void materialize() const {
+            uint32_t s  = get_encoded_size();
+            uint16_t o  = ResourceView::get_header_size(get_name().length());
+            Byte_t   *p = NULL;
+            Buffer_t  b = make_buffer(o + s + (s & 0x1),p,get_memory_resource());
+
+            encode(p);
+
+            _buf   = b;
+            _raw   = p;
+            _size  = s;
+            _doff  = o;
+            _dirty = false;
+        }
+
+        void assign(const ResourceView & v) {
+            _raw  = v.get_raw();
+            _size = v.get_data_size();
+            _doff = v.get_data_offset();
+            _id   = v.get_id();
+        }
+
+        mutable const Byte_t * _raw;   //< The blob, either read by the TIFFLib or held by _buf
+        mutable Buffer_t       _buf;   //< Keeps _raw alive if we own (a share of) it
+        mutable uint32_t       _size;
+        mutable uint16_t       _doff;  //< Offset of the data within the blob
+        mutable bool           _dirty; //< Content modified since the blob has been built
         ResourceId        _id;
-        std::string       _name;
+        std::pmr::string  _name;  //< Only used by resources built from scratch
     };
 
     inline
     std::ostream & operator<<(std::ostream & os,const Resource & r) {
-        return os << r.get_data_size() << "/" << r.get_size() << std::endl << r.to_string();
+        return os << r.get_data_size() << "/" << r.get_size() << '\n' << r.to_string();
     }
 
     /**
@@ -198,39 +351,43 @@ namespace PsTiff
             int16_t v[4];
         } Channel_t;
 
-        SpotColorResource(const Byte_t *p) : super(p)  {
-            if(get_id()!=ResourceId::AlternateSpotColors) {
-                std::stringstream ss;
-                ss << "illegal id #" << get_id() << " for SpotColorResource";
-                throw std::runtime_error(ss.str());
-            }
+        /** Most files carry a handful of spot channels only
+         */
 
-            if(get_size()<4)
-                throw  std::runtime_error("SpotColorResource has to have a size of min 4");
+        typedef Tools::SmallVector<Channel_t,4> Channels_t;
 
+        SpotColorResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr),_ch(mr) {
+            parse();
+        }
 
-            _v = to16(get_data()+0);
-            _s = to16(get_data()+2);
+        SpotColorResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr),_ch(mr) {
+            parse();
+        }
 
-            if(get_data_size() != _s * 14 + 4 )
-            {
-                std::stringstream ss;
-                ss << "expected data of SpotColorResources to have size " << _s*14+4
-                   << " but found " << get_data_size();
-                throw std::runtime_error(ss.str());
-            }
-            const Byte_t * pp=get_data()+4;
+        /** Check the block v without decoding it
+         */
 
-            for(int i=0;i<_s;i++) {
-                _ch.push_back(Channel_t(to32(pp),to16(pp+4),
-                                        to16(pp+6),to16(pp+8),to16(pp+10),to16(pp+12)));
-                pp+=14;
-            }
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::AlternateSpotColors)
+                return wrong_id();
 
+            if(v.get_data_size()<4)
+                return fail(ParseStatus::BadSize,v);
+
+            if(v.get_data_size() != to16(v.get_data()+2) * ChannelSize + 4)
+                return fail(ParseStatus::BadSize,v,2);
+
+            return ParseStatus();
         }
 
-        SpotColorResource() : super("",ResourceId::AlternateSpotColors) {
+        virtual
+        SpotColorResource * clone() const {
+            return new SpotColorResource(*this);
+        }
 
+        explicit
+        SpotColorResource(Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::AlternateSpotColors,mr),_v(1),_s(0),_ch(mr) {
+            touch();
         }
 
         size_t get_count() const {
@@ -248,7 +405,34 @@ namespace PsTiff
 
         void push_back(const Channel_t & c) {
             _ch.push_back(c);
-            rebuild();
+            touch();
+        }
+
+        void reserve(size_t n) {
+            _ch.reserve(n);
+        }
+
+        /** Append the Channels [b;e)
+         */
+
+        template<class I>
+        void append(I b,I e) {
+            _ch.append(b,e);
+            touch();
+        }
+
+        /** Replace all Channels by [b;e)
+         */
+
+        template<class I>
+        void assign(I b,I e) {
+            _ch.assign(b,e);
+            touch();
+        }
+
+        void clear() {
+            _ch.clear();
+            touch();
         }
 
         virtual
@@ -263,33 +447,66 @@ namespace PsTiff
             }
             return ss.str();
         }
+
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("version").uint(_v);
+            e.key("channels").begin_array();
+            for(const Channel_t & c : _ch) {
+                e.begin_object();
+                e.key("id").uint(c.id);
+                e.key("space").uint(c.sp);
+                e.key("color").begin_array();
+                for(int j=0;j<4;j++)
+                    e.sint(c.v[j]);
+                e.end_array();
+                e.end_object();
+            }
+            e.end_array();
+        }
     private:
-         void rebuild() {
-             int s = sizeof(uint16_t)*2;
-             for(std::vector<Channel_t>::const_iterator i=_ch.begin();i!=_ch.end();i++) {
-                 s+=sizeof(uint32_t)+sizeof(uint16_t)*5;
-             }
-             Byte_t * p  = new Byte_t[s];
-             ::memset(p,0,s);
-             Byte_t * pp = p;
-             pp=from16(pp,1);
-             pp=from16(pp,get_count());
-             for(int i=0;i<get_count();i++) {
-                 pp=from32(pp,(*this)[i].id);
-                 pp=from16(pp,(*this)[i].sp);
-                 pp=from16(pp,(*this)[i].v[0]);
-                 pp=from16(pp,(*this)[i].v[1]);
-                 pp=from16(pp,(*this)[i].v[2]);
-                 pp=from16(pp,(*this)[i].v[3]);
-
-             }
-             super::rebuild(p,s);
-             delete[] p;
-         }
+        void parse() {
+            validate(get_view()).check();
 
-         uint16_t               _v;  // version
-         uint16_t               _s;  // size aka # of channels
-         std::vector<Channel_t> _ch; // extra channels
+            _v = to16(get_data()+0);
+            _s = to16(get_data()+2);
+
+            const Byte_t * pp=get_data()+4;
+
+            _ch.reserve(_s);
+
+            for(int i=0;i<_s;i++) {
+                _ch.push_back(Channel_t(to32(pp),to16(pp+4),
+                                        to16(pp+6),to16(pp+8),to16(pp+10),to16(pp+12)));
+                pp+=ChannelSize;
+            }
+        }
+
+        virtual
+        uint32_t get_encoded_size() const {
+            return sizeof(uint16_t) * 2 + get_count() * ChannelSize;
+        }
+
+        virtual
+        Byte_t * encode_data(Byte_t * pp) const {
+            pp=from16(pp,_v);
+            pp=from16(pp,get_count());
+            for(Channels_t::const_iterator i=_ch.begin();i!=_ch.end();i++) {
+                pp=from32(pp,(*i).id);
+                pp=from16(pp,(*i).sp);
+                pp=from16(pp,(*i).v[0]);
+                pp=from16(pp,(*i).v[1]);
+                pp=from16(pp,(*i).v[2]);
+                pp=from16(pp,(*i).v[3]);
+            }
+            return pp;
+        }
+
+        static const int ChannelSize = sizeof(uint32_t) + sizeof(uint16_t) * 5;
+
+        uint16_t               _v;  // version
+        uint16_t               _s;  // size aka # of channels
+        Channels_t             _ch; // extra channels
     };
 
     template<class C>
@@ -300,9 +517,24 @@ namespace PsTiff
         static std::string name() {
             return "ALPHANAMES";
         }
-        typedef std::basic_string<char> String_t;
+        typedef std::pmr::basic_string<char> String_t;
         static std::string to_str(const String_t & s) {
-            return s;
+            return std::string(s);
+        }
+
+        /** Pascal string <N>char[N]
+         */
+
+        static size_t get_size(const String_t & s) {
+            return 1 + s.length();
+        }
+
+        static Byte_t * encode(Byte_t * p,const String_t & s) {
+            return fromstr(p,s);
+        }
+
+        static void emit(IO::Emitter & e,const String_t & s) {
+            e.mac_string(s);
         }
     };
 
@@ -311,10 +543,29 @@ namespace PsTiff
         static std::string name () {
             return "UALPHANAMES";
         }
-        typedef std::basic_string<wchar_t> String_t;
+        typedef std::pmr::basic_string<wchar_t> String_t;
         static std::string to_str(const String_t & s) {
             return Tools::from_wstring(s);
         }
+
+        /** Unicode string <N>uint16_t[N] with N counting the
+            terminating 0.
+         */
+
+        static size_t get_size(const String_t & s) {
+            return sizeof(uint32_t) + (s.length() + 1) * sizeof(uint16_t);
+        }
+
+        static Byte_t * encode(Byte_t * p,const String_t & s) {
+            p = from32(p,s.length()+1);
+            for(size_t i=0;i<s.length();i++)
+                p = from16(p,s[i]);
+            return from16(p,0);
+        }
+
+        static void emit(IO::Emitter & e,const String_t & s) {
+            e.string(std::wstring_view(s));
+        }
     };
 
     /** templated base class for all alpha channel names-
@@ -328,15 +579,20 @@ namespace PsTiff
 
 
     public:
-        typedef std::basic_string<CI> String_t;
+        typedef std::pmr::basic_string<CI> String_t;
+        typedef std::basic_string_view<CI> View_t;
         typedef CI                    Char_t;
         typedef CE                    Ext_t;
         typedef NameTraits<CE>        Traits_t;
+        typedef Tools::SmallVector<String_t,2> Names_t;
+
+        BasicAlphaNamesResource(const Byte_t * p,Memory_t * mr) : super(p,mr),_c(mr) {
+        }
 
-        BasicAlphaNamesResource(const Byte_t * p) : super(p) {
+        BasicAlphaNamesResource(const ResourceView & v,Memory_t * mr) : super(v,mr),_c(mr) {
         }
 
-        BasicAlphaNamesResource(const std::string & name, ResourceId::Enum_t e ) : super(name,e) {
+        BasicAlphaNamesResource(std::string_view name, ResourceId::Enum_t e,Memory_t * mr) : super(name,e,mr),_c(mr) {
         }
 
         const String_t & operator[](size_t idx) const {
@@ -348,16 +604,42 @@ namespace PsTiff
         String_t & operator[](size_t i) {
             if(i>=_c.size())
                 throw std::runtime_error("illegal idx");
+            touch();
             return _c[i];
         }
 
         void clear() {
             _c.clear();
+            touch();
+        }
+
+        void push_back(View_t s) {
+            _c.emplace_back(s);
+            touch();
+        }
+
+        void reserve(size_t n) {
+            _c.reserve(n);
+        }
+
+        /** Append the names [b;e)
+         */
+
+        template<class I>
+        void append(I b,I e) {
+            _c.reserve(_c.size() + std::distance(b,e));
+            for(;b!=e;++b)
+                _c.emplace_back(View_t(*b));
+            touch();
         }
 
-        void push_back(const String_t & s) {
-            _c.push_back(s);
-            rebuild();
+        /** Replace all names by [b;e)
+         */
+
+        template<class I>
+        void assign(I b,I e) {
+            _c.clear();
+            append(b,e);
         }
 
         size_t size() const {
@@ -367,7 +649,7 @@ namespace PsTiff
         virtual
         std::string to_string() const {
             std::stringstream ss;
-            ss << Traits_t::name << " " << size() << " (";
+            ss << Traits_t::name() << " " << size() << " (";
             for(int i=0;i < size();i++) {
                 ss << ( i==0 ? "" : ";") << Traits_t::to_str((*this)[i]);
             }
@@ -375,27 +657,43 @@ namespace PsTiff
             return ss.str();
         }
 
-    protected:
-        void rebuild() {
-
-            int s = 0;
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("names").begin_array();
+            for(size_t i=0;i<size();i++)
+                Traits_t::emit(e,_c[i]);
+            e.end_array();
+        }
 
-            for(typename std::vector<String_t>::const_iterator i=_c.begin();i!=_c.end();i++)
-                s += 1 + (*i).length() * sizeof(Ext_t);
+    protected:
+        /** Add a name found while parsing; the blob stays untouched.
+         */
 
-            Byte_t *p  = new Byte_t[s];
-            Byte_t *p0 = p;
+        void add_parsed(String_t && s) {
+            _c.push_back(std::move(s));
+        }
 
-            for(typename std::vector<String_t>::const_iterator i=_c.begin();i!=_c.end();i++) {
-                p0 = fromstr(p0,*i);
-            }
+        typename String_t::allocator_type get_allocator() const {
+            return typename String_t::allocator_type(_c.get_memory_resource());
+        }
 
-            super::rebuild(p,s);
+        virtual
+        uint32_t get_encoded_size() const {
+            uint32_t s = 0;
+            for(typename Names_t::const_iterator i=_c.begin();i!=_c.end();i++)
+                s += Traits_t::get_size(*i);
+            return s;
+        }
 
-            delete[] p;
+        virtual
+        Byte_t * encode_data(Byte_t * p) const {
+            for(typename Names_t::const_iterator i=_c.begin();i!=_c.end();i++)
+                p = Traits_t::encode(p,*i);
+            return p;
         }
+
     private:
-        std::vector<String_t> _c;
+        Names_t _c;
     };
 
     /**
@@ -408,11 +706,48 @@ namespace PsTiff
     private:
         typedef BasicAlphaNamesResource<char,char> super;
     public:
-        AlphaNamesResource(const Byte_t * p) : super(p) {
-            clear();
-            String_t s;
-            if(get_id()!=ResourceId::AlphaNames)
-                throw std::runtime_error("Expected AlphaNames Resource Id");
+        AlphaNamesResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr) {
+            parse();
+        }
+
+        AlphaNamesResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr) {
+            parse();
+        }
+
+        /** Check the block v without decoding it. A zero length name
+            ends the list.
+         */
+
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::AlphaNames)
+                return wrong_id();
+
+            const Byte_t * p = v.get_data();
+            size_t         s = v.get_data_size();
+            size_t         o = 0;
+
+            while(o<s && p[o]!=0) {
+                if(s - o - 1 < p[o])
+                    return fail(ParseStatus::BadContent,v,o);
+                o += 1 + p[o];
+            }
+
+            return ParseStatus();
+        }
+
+        virtual
+        AlphaNamesResource * clone() const {
+            return new AlphaNamesResource(*this);
+        }
+
+        explicit
+        AlphaNamesResource(Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::AlphaNames,mr) {
+            touch();
+        }
+
+    private:
+        void parse() {
+            validate(get_view()).check();
 
             const Byte_t *p0;
             const Byte_t *p1;
@@ -423,21 +758,11 @@ namespace PsTiff
 
                 while( (p1-p0) < s && (n=to8(p1)))
                 {
-                    push_back(String_t((Char_t*)(p1+sizeof(Byte_t)),(int)n));
+                    add_parsed(String_t((Char_t*)(p1+sizeof(Byte_t)),n,get_allocator()));
                     p1+=sizeof(Byte_t)+n;
                 }
             }
 
-            if(p1-p0!=get_data_size()) {
-                std::stringstream ss;
-                ss << "expected " << get_data_size() << " bytes; found " << (p1-p1) << std::endl;
-            }
-
-            rebuild();
-        }
-
-        AlphaNamesResource() : super("",ResourceId::AlphaNames) {
-
         }
     };
 
@@ -451,12 +776,48 @@ namespace PsTiff
     private:
         typedef BasicAlphaNamesResource<wchar_t,uint16_t> super;
     public:
-        UnicodeAlphaNamesResource(const Byte_t * p) : super(p) {
-            clear();
-            String_t s;
+        UnicodeAlphaNamesResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr) {
+            parse();
+        }
+
+        UnicodeAlphaNamesResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr) {
+            parse();
+        }
+
+        /** Check the block v without decoding it
+         */
+
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::UnicodeAlphaNames)
+                return wrong_id();
+
+            const Byte_t * p = v.get_data();
+            size_t         s = v.get_data_size();
+            size_t         o = 0;
+
+            while(o + sizeof(uint32_t) < s) {
+                uint32_t n = to32(p+o);
+                if((s - o - sizeof(uint32_t)) / sizeof(uint16_t) < n)
+                    return fail(ParseStatus::BadContent,v,o);
+                o += sizeof(uint32_t) + (size_t)n * sizeof(uint16_t);
+            }
+
+            return ParseStatus();
+        }
+
+        virtual
+        UnicodeAlphaNamesResource * clone() const {
+            return new UnicodeAlphaNamesResource(*this);
+        }
 
-            if(get_id()!=ResourceId::UnicodeAlphaNames)
-                throw std::runtime_error("Expected AlphaNames Resource Id");
+        explicit
+        UnicodeAlphaNamesResource(Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::UnicodeAlphaNames,mr) {
+            touch();
+        }
+
+    private:
+        void parse() {
+            validate(get_view()).check();
 
             const Byte_t *p0;
             const Byte_t *p1;
@@ -464,7 +825,7 @@ namespace PsTiff
             if((p1=p0=get_data()) != NULL) {
                 while(( ( p1 + sizeof(uint32_t) - p0 ) < get_data_size()))
                 {
-                    String_t w;
+                    String_t w(get_allocator());
                     uint32_t  n = to32(p1);
 
                     p1+=sizeof(uint32_t);
@@ -475,7 +836,7 @@ namespace PsTiff
                             w+=Char_t(to16(p1));
                         p1+=sizeof(uint16_t);
                     }
-                    push_back(w);
+                    add_parsed(std::move(w));
                 }
             }
 
@@ -483,11 +844,6 @@ namespace PsTiff
                 std::stringstream ss;
                 ss << "expected " << get_data_size() << " bytes; found " << (p1-p1) << std::endl;
             }
-
-            std::cerr << " > - - - - - - " << get_data_size() << "/" << get_size() << std::endl
-                      << IO::hex_dump(get_data(),get_data_size()) << std::endl
-                      << " < - - - - - - " << std::endl;
-
         }
     };
 
@@ -501,30 +857,69 @@ namespace PsTiff
     private:
         typedef Resource super;
     public:
+        typedef Tools::SmallVector<uint32_t,8> Ids_t;
 
-        AlphaIdentifiersResource(const Byte_t * p) : super(p) {
-            if(get_id()!=ResourceId::AlphaIdentifiers)
-                throw std::runtime_error("Expected AlphaChannelIds");
+        AlphaIdentifiersResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr),_c(mr) {
+            parse();
+        }
 
-            if((get_data_size() % sizeof(uint32_t))!=0)
-                throw std::runtime_error("Illegal size of AlphaChannelIdsResource");
+        AlphaIdentifiersResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr),_c(mr) {
+            parse();
+        }
 
-            int n = get_data_size() / sizeof(uint32_t);
+        /** Check the block v without decoding it
+         */
 
-            for(int i=0;i<n;i++) {
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::AlphaIdentifiers)
+                return wrong_id();
 
-                _c.push_back(to32(get_data()+i*sizeof(uint32_t)));
-            }
-            rebuild();
+            if((v.get_data_size() % sizeof(uint32_t))!=0)
+                return fail(ParseStatus::BadSize,v);
+
+            return ParseStatus();
         }
 
-        AlphaIdentifiersResource() : super("",ResourceId::AlphaIdentifiers) {
+        virtual
+        AlphaIdentifiersResource * clone() const {
+            return new AlphaIdentifiersResource(*this);
+        }
 
+        explicit
+        AlphaIdentifiersResource(Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::AlphaIdentifiers,mr),_c(mr) {
+            touch();
         }
 
         void push_back(uint32_t n) {
             _c.push_back(n);
-            rebuild();
+            touch();
+        }
+
+        void reserve(size_t n) {
+            _c.reserve(n);
+        }
+
+        /** Append the Ids [b;e)
+         */
+
+        template<class I>
+        void append(I b,I e) {
+            _c.append(b,e);
+            touch();
+        }
+
+        /** Replace all Ids by [b;e)
+         */
+
+        template<class I>
+        void assign(I b,I e) {
+            _c.assign(b,e);
+            touch();
+        }
+
+        void clear() {
+            _c.clear();
+            touch();
         }
 
         size_t size() const {
@@ -544,6 +939,7 @@ namespace PsTiff
                 throw std::runtime_error("access to illegal idx");
 
             }
+            touch();
             return _c[idx];
         }
 
@@ -558,20 +954,36 @@ namespace PsTiff
             return ss.str();
         }
 
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("ids").begin_array();
+            for(size_t i=0;i<size();i++)
+                e.uint(_c[i]);
+            e.end_array();
+        }
+
     private:
-        void rebuild() {
-            int s=size() * sizeof(uint32_t);
-            Byte_t * p  = new Byte_t[s];
-            Byte_t * pp = p;
-            ::memset(p,0,s);
-            for(int i=0;i<size();i++) {
-                pp = from32(pp,(*this)[i]);
-            }
-            super::rebuild(p,s);
-            delete[] p;
+        void parse() {
+            validate(get_view()).check();
+
+            size_t n = get_data_size() / sizeof(uint32_t);
+
+            _c.resize(n);
+
+            decode32(_c.data(),get_data(),n);
+        }
+
+        virtual
+        uint32_t get_encoded_size() const {
+            return size() * sizeof(uint32_t);
+        }
+
+        virtual
+        Byte_t * encode_data(Byte_t * pp) const {
+            return encode32(pp,_c.data(),_c.size());
         }
 
-        std::vector<uint32_t> _c;
+        Ids_t _c;
     };
 
     /**
@@ -584,17 +996,38 @@ namespace PsTiff
     private:
         typedef Resource super;
     public:
-        IdSeedNumberResource(const Byte_t *p)  : super(p) {
-            if(get_id()!=ResourceId::IdSeedNumber)
-                throw std::runtime_error("Expected IsSeedNumberId");
+        IdSeedNumberResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr) {
+            parse();
+        }
 
-            if((get_data_size() != sizeof(uint32_t)))
-                throw std::runtime_error("Illegal size of IdSeedNumberResource");
-            _seed = to32(get_data());
+        IdSeedNumberResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr) {
+            parse();
+        }
+
+        /** Check the block v without decoding it
+         */
+
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::IdSeedNumber)
+                return wrong_id();
+
+            if(v.get_data_size() != sizeof(uint32_t))
+                return fail(ParseStatus::BadSize,v);
+
+            return ParseStatus();
+        }
+
+        virtual
+        IdSeedNumberResource * clone() const {
+            return new IdSeedNumberResource(*this);
         }
 
-        IdSeedNumberResource(int id) : super("",ResourceId::IdSeedNumber),_seed(id) {
-            rebuild();
+        IdSeedNumberResource(int id,Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::IdSeedNumber,mr),_seed(id) {
+            touch();
+        }
+
+        int get_seed() const {
+            return _seed;
         }
 
         virtual
@@ -605,12 +1038,28 @@ namespace PsTiff
             return ss.str();
          }
 
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("seed").sint(_seed);
+        }
+
     private:
-        void rebuild() {
-            Byte_t b[4];
-            from32(b,_seed);
-            super::rebuild(b,sizeof(uint32_t));
+        void parse() {
+            validate(get_view()).check();
+
+            _seed = to32(get_data());
+        }
+
+        virtual
+        uint32_t get_encoded_size() const {
+            return sizeof(uint32_t);
         }
+
+        virtual
+        Byte_t * encode_data(Byte_t * p) const {
+            return from32(p,_seed);
+        }
+
         int _seed;
     };
 
@@ -619,35 +1068,47 @@ namespace PsTiff
     private:
         typedef Resource super;
     public:
-        VersionInfoResource(const Byte_t * p) : super(p),_v(0),_has_merged_data(false) {
-            if(get_id()!=ResourceId::VersionInfo) {
-                throw std::runtime_error("Expected VersionInfoId");
-            }
+        VersionInfoResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource())
+            : super(p,mr),_has_merged_data(false),_v(0),_reader_name(mr),_writer_name(mr) {
+            parse();
+        }
 
-            if(get_size()<5)
-                throw  std::runtime_error("VersionInfoResource has to have a size of min 5");
+        VersionInfoResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource())
+            : super(v,mr),_has_merged_data(false),_v(0),_reader_name(mr),_writer_name(mr) {
+            parse();
+        }
 
-            _v = to32(get_data()+0);
-            _has_merged_data = *(get_data()+4) != 0x00;
+        /** Check the block v without decoding it. Version, merged flag
+            and the two length prefixed UTF-16 names have to be there.
+         */
 
-            int s0 = to32(get_data()+5);
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::VersionInfo)
+                return wrong_id();
 
+            const Byte_t * p = v.get_data();
+            size_t         s = v.get_data_size();
+            size_t         o = 5;
 
-            {
-                std::wstring ws;
-                for(int i=0;i<s0;i++)
-                    ws+=wchar_t(to16(get_data()+9+i*2));
-                _reader_name=ws;
-            }
+            for(int i=0;i<2;i++) {
+                if(s < o || s - o < sizeof(uint32_t))
+                    return fail(ParseStatus::BadSize,v,o);
 
-            int s1 = to32(get_data()+9+s0*2);
+                uint32_t n = to32(p+o);
+                o += sizeof(uint32_t);
 
-            {
-                std::wstring ws;
-                for(int i=0;i<s1;i++)
-                    ws+=wchar_t(to16(get_data()+13+s0*2+i*2));
-                _writer_name=ws;
+                if((s - o) / sizeof(uint16_t) < n)
+                    return fail(ParseStatus::BadContent,v,o - sizeof(uint32_t));
+
+                o += (size_t)n * sizeof(uint16_t);
             }
+
+            return ParseStatus();
+        }
+
+        virtual
+        VersionInfoResource * clone() const {
+            return new VersionInfoResource(*this);
         }
 
         uint32_t get_version() const {
@@ -658,11 +1119,11 @@ namespace PsTiff
             return _has_merged_data;
         }
 
-        std::wstring get_reader_name() const {
+        std::wstring_view get_reader_name() const {
             return _reader_name;
         }
 
-        std::wstring get_writer_name() const {
+        std::wstring_view get_writer_name() const {
             return _writer_name;
         }
 
@@ -676,11 +1137,39 @@ namespace PsTiff
             return ss.str();
          }
 
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("version").uint(get_version());
+            e.key("has_merged_data").boolean(has_merged_data());
+            e.key("reader").string(get_reader_name());
+            e.key("writer").string(get_writer_name());
+        }
+
     private:
+        void parse() {
+            validate(get_view()).check();
+
+            _v = to32(get_data()+0);
+            _has_merged_data = *(get_data()+4) != 0x00;
+
+            int s0 = to32(get_data()+5);
+
+
+            _reader_name.reserve(s0);
+            for(int i=0;i<s0;i++)
+                _reader_name+=wchar_t(to16(get_data()+9+i*2));
+
+            int s1 = to32(get_data()+9+s0*2);
+
+            _writer_name.reserve(s1);
+            for(int i=0;i<s1;i++)
+                _writer_name+=wchar_t(to16(get_data()+13+s0*2+i*2));
+        }
+
         bool     _has_merged_data;
         uint32_t _v;
-        std::wstring _reader_name;
-        std::wstring _writer_name;
+        std::pmr::wstring _reader_name;
+        std::pmr::wstring _writer_name;
     };
 
 
@@ -732,43 +1221,71 @@ namespace PsTiff
             Byte_t   padding;    /* Padding */
         };
 
-        DisplayInfoResource(const Byte_t * p) : super( p ) {
+        static_assert(sizeof(DisplayInfo)==14,"DisplayInfo has to match the on disk record");
 
-            if(get_id()!=ResourceId::DisplayInfo) {
-                throw std::runtime_error("Expected DisplayInfoId");
-            }
+        typedef Tools::SmallVector<DisplayInfo,4> Infos_t;
 
-            if(this->get_data_size() % sizeof(DisplayInfo) != 0) {
-                std::stringstream ss;
-                ss << "expected DisplayInfoResource size to be a multitude of " << sizeof(DisplayInfo) << " found "
-                   << get_size();
-                throw std::runtime_error(ss.str());
-            }
+        DisplayInfoResource(const Byte_t * p,Memory_t * mr=std::pmr::get_default_resource()) : super(p,mr),_v(mr) {
+            parse();
+        }
 
-            for(const Byte_t *p = get_data();p<get_data()+get_data_size();p+=sizeof(DisplayInfo)) {
-                DisplayInfo di;
-                di.colorspace = to16(p);
+        DisplayInfoResource(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) : super(v,mr),_v(mr) {
+            parse();
+        }
 
-                for(int i=0;i<4;i++) {
-                    di.color[i]=to16(p+sizeof(uint16_t)+i*sizeof(uint16_t));
-                }
+        /** Check the block v without decoding it
+         */
 
-                di.opacity = to16(p + sizeof(uint16_t) + 4 * sizeof(uint16_t) );
-                di.kind    = to8( p + sizeof(uint16_t) + 5 * sizeof(uint16_t) );
-                di.padding = 0;
+        static ParseStatus validate(const ResourceView & v) noexcept {
+            if(v.get_id()!=ResourceId::DisplayInfo)
+                return wrong_id();
 
-                _v.push_back(di);
-            }
+            if(v.get_data_size() % sizeof(DisplayInfo) != 0)
+                return fail(ParseStatus::BadSize,v);
 
+            return ParseStatus();
         }
 
-        DisplayInfoResource() : super("",ResourceId::DisplayInfo) {
+        virtual
+        DisplayInfoResource * clone() const {
+            return new DisplayInfoResource(*this);
+        }
 
+        explicit
+        DisplayInfoResource(Memory_t * mr=std::pmr::get_default_resource()) : super("",ResourceId::DisplayInfo,mr),_v(mr) {
+            touch();
         }
 
         void add(const DisplayInfo & di) {
             _v.push_back(di);
-            rebuild();
+            touch();
+        }
+
+        void reserve(size_t n) {
+            _v.reserve(n);
+        }
+
+        /** Append the DisplayInfos [b;e)
+         */
+
+        template<class I>
+        void append(I b,I e) {
+            _v.append(b,e);
+            touch();
+        }
+
+        /** Replace all DisplayInfos by [b;e)
+         */
+
+        template<class I>
+        void assign(I b,I e) {
+            _v.assign(b,e);
+            touch();
+        }
+
+        void clear() {
+            _v.clear();
+            touch();
         }
 
         size_t size() const {
@@ -799,31 +1316,101 @@ namespace PsTiff
             return ss.str();
         }
 
+        virtual
+        void emit(IO::Emitter & e) const {
+            e.key("infos").begin_array();
+            for(const DisplayInfo & d : _v) {
+                e.begin_object();
+                e.key("colorspace").uint(d.colorspace);
+                e.key("color").begin_array();
+                for(int j=0;j<4;j++)
+                    e.uint(d.color[j]);
+                e.end_array();
+                e.key("opacity").uint(d.opacity);
+                e.key("kind").uint(d.kind);
+                e.end_object();
+            }
+            e.end_array();
+        }
+
     private:
+        void parse() {
+            validate(get_view()).check();
 
-        void rebuild() {
+            size_t n = get_data_size() / sizeof(DisplayInfo);
 
-            int s = size() * sizeof(DisplayInfo);
+            _v.resize(n);
 
-            Byte_t * p  = new Byte_t[s];
-            Byte_t * pp = p;
+            // Swap the words of a chunk of records at once and fill the
+            // fields from them; the kind is a single byte.
 
-            for(std::vector<DisplayInfo>::const_iterator i=_v.begin();i!=_v.end();i++) {
+            uint16_t w[Chunk * WordsPerInfo];
 
-                pp = from16(pp,(*i).colorspace);
-                for(int j=0;j<4;j++)
-                   pp = from16(pp,(*i).color[j]);
-                pp = from16(pp,(*i).opacity);
-                pp = from8( pp,(*i).kind);
-                pp = from8( pp,(*i).padding);
+            for(size_t i=0;i<n;i+=Chunk) {
+                size_t         m = std::min(Chunk,n-i);
+                const Byte_t * p = get_data() + i * sizeof(DisplayInfo);
+
+                decode16(w,p,m * WordsPerInfo);
+
+                for(size_t j=0;j<m;j++) {
+                    const uint16_t * r = w + j * WordsPerInfo;
+                    DisplayInfo    & d = _v[i+j];
+
+                    d.colorspace = r[0];
+                    d.color[0]   = r[1];
+                    d.color[1]   = r[2];
+                    d.color[2]   = r[3];
+                    d.color[3]   = r[4];
+                    d.opacity    = r[5];
+                    d.kind       = to8(p + j * sizeof(DisplayInfo) + KindOffset);
+                    d.padding    = 0;
+                }
             }
+        }
 
-            super::rebuild(p,s);
+        virtual
+        uint32_t get_encoded_size() const {
+            return size() * sizeof(DisplayInfo);
+        }
+
+        virtual
+        Byte_t * encode_data(Byte_t * pp) const {
+            uint16_t w[Chunk * WordsPerInfo];
+
+            for(size_t i=0;i<_v.size();i+=Chunk) {
+                size_t m = std::min(Chunk,_v.size()-i);
+
+                for(size_t j=0;j<m;j++) {
+                    uint16_t          * r = w + j * WordsPerInfo;
+                    const DisplayInfo & d = _v[i+j];
+
+                    r[0] = d.colorspace;
+                    r[1] = d.color[0];
+                    r[2] = d.color[1];
+                    r[3] = d.color[2];
+                    r[4] = d.color[3];
+                    r[5] = d.opacity;
+                    r[6] = 0;
+                }
+
+                Byte_t * p = pp + i * sizeof(DisplayInfo);
 
-            delete[] p;
+                encode16(p,w,m * WordsPerInfo);
+
+                for(size_t j=0;j<m;j++) {
+                    from8(p + j * sizeof(DisplayInfo) + KindOffset + 0,_v[i+j].kind);
+                    from8(p + j * sizeof(DisplayInfo) + KindOffset + 1,_v[i+j].padding);
+                }
+            }
+
+            return pp + _v.size() * sizeof(DisplayInfo);
         }
 
-        std::vector<DisplayInfo> _v;
+        static const size_t WordsPerInfo = sizeof(DisplayInfo) / sizeof(uint16_t);
+        static const size_t KindOffset   = 6 * sizeof(uint16_t);
+        static constexpr size_t Chunk    = 64;  //< records swapped at once
+
+        Infos_t _v;
     };
 }
 
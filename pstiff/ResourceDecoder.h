@@ -0,0 +1,232 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_RESOURCEDECODER_H
+#define PSTIFF_RESOURCEDECODER_H
+
+#include "pstiff/Resource.h"
+#include "pstiff/ResourceView.h"
+
+#include <memory>
+
+namespace PsTiff {
+
+    /**
+     * @brief The ResourceDecoder class
+     *
+     * Registry mapping every ResourceId::Enum_t onto the function
+     * turning a ResourceView into its typed Resource. Blocks without
+     * a registered decoder become plain Resources, blocks which have
+     * not been selected are skipped without being decoded at all.
+     *
+     * The Resources, their control blocks and everything they allocate
+     * come from the memory resource passed to decode(); decoding into
+     * a std::pmr::monotonic_buffer_resource lets a whole file get
+     * released at once.
+     */
+
+    class ResourceDecoder {
+    public:
+        typedef std::shared_ptr<Resource> Result_t;
+        typedef Result_t (*Decode_t)(const ResourceView &,Memory_t *);
+        typedef ParseStatus (*Validate_t)(const ResourceView &);
+
+        /** Default decode function for the typed Resource R
+         */
+
+        template<class R>
+        static Result_t Decode(const ResourceView & v,Memory_t * mr) {
+            return std::allocate_shared<R>(std::pmr::polymorphic_allocator<R>(mr),v,mr);
+        }
+
+        /** Create a registry knowing all typed resources of this
+            library with every Id selected.
+         */
+
+        ResourceDecoder() {
+            for(int i=0;i<ResourceId::EnumCount;i++) {
+                _f[i]   = NULL;
+                _v[i]   = NULL;
+                _sel[i] = true;
+            }
+            set(ResourceId::AlternateSpotColors, Decode<SpotColorResource>,         SpotColorResource::validate);
+            set(ResourceId::AlphaNames,          Decode<AlphaNamesResource>,        AlphaNamesResource::validate);
+            set(ResourceId::UnicodeAlphaNames,   Decode<UnicodeAlphaNamesResource>, UnicodeAlphaNamesResource::validate);
+            set(ResourceId::AlphaIdentifiers,    Decode<AlphaIdentifiersResource>,  AlphaIdentifiersResource::validate);
+            set(ResourceId::IdSeedNumber,        Decode<IdSeedNumberResource>,      IdSeedNumberResource::validate);
+            set(ResourceId::VersionInfo,         Decode<VersionInfoResource>,       VersionInfoResource::validate);
+            set(ResourceId::DisplayInfo,         Decode<DisplayInfoResource>,       DisplayInfoResource::validate);
+        }
+
+        /** Register f as decoder for e. Passing NULL removes the
+            decoder and blocks of type e get decoded as plain Resource.
+            v checks a block before f gets to see it. Decoders without
+            one have to throw on malformed blocks themselves.
+         */
+
+        void set(ResourceId::Enum_t e,Decode_t f,Validate_t v=NULL) {
+            _f[check(e)] = f;
+            _v[e]        = v;
+        }
+
+        Decode_t get(ResourceId::Enum_t e) const {
+            return _f[check(e)];
+        }
+
+        Validate_t get_validator(ResourceId::Enum_t e) const {
+            return _v[check(e)];
+        }
+
+        /** Check the block v with the validator registered for its Id
+         */
+
+        ParseStatus validate(const ResourceView & v) const noexcept {
+            ResourceId::Enum_t e = v.get_id().to_enum();
+            return _v[e]==NULL ? ParseStatus() : _v[e](v);
+        }
+
+        bool has(ResourceId::Enum_t e) const {
+            return get(e)!=NULL;
+        }
+
+        void select(ResourceId::Enum_t e,bool on=true) {
+            _sel[check(e)] = on;
+        }
+
+        template<class I>
+        void select(I b,I e) {
+            for(;b!=e;b++)
+                select(*b);
+        }
+
+        void select_all(bool on=true) {
+            for(int i=0;i<ResourceId::EnumCount;i++)
+                _sel[i] = on;
+        }
+
+        void select_none() {
+            select_all(false);
+        }
+
+        /** Only keep those Ids selected which have a decoder
+         */
+
+        void select_registered() {
+            for(int i=0;i<ResourceId::EnumCount;i++)
+                _sel[i] = _sel[i] && _f[i]!=NULL;
+        }
+
+        bool is_selected(ResourceId::Enum_t e) const {
+            return _sel[check(e)];
+        }
+
+        /** Decode a single block. Returns an empty pointer if the
+            Id of the block has not been selected.
+         */
+
+        Result_t decode(const ResourceView & v,Memory_t * mr=std::pmr::get_default_resource()) const {
+            ResourceId::Enum_t e = v.get_id().to_enum();
+
+            if(!_sel[e])
+                return Result_t();
+
+            return _f[e]==NULL ? Decode<Resource>(v,mr) : _f[e](v,mr);
+        }
+
+        /** Walk the blob p[n] once and call f(view,result) for
+            every selected block.
+         */
+
+        template<class F>
+        void decode(const Byte_t * p,size_t n,F f,Memory_t * mr=std::pmr::get_default_resource()) const {
+            try_decode(p,n,f,Strict,NULL,mr).check();
+        }
+
+        /** Non throwing version of decode(). Malformed block headers
+            and selected blocks failing their validator are handled
+            according to pol and added to d. Returns the first error
+            (offset relative to p) or Ok.
+         */
+
+        template<class F>
+        ParseStatus try_decode(const Byte_t * p,size_t n,F f,ParsePolicy_t pol=Strict,ParseDiagnostics * d=NULL,
+                               Memory_t * mr=std::pmr::get_default_resource()) const {
+            return try_select(p,n,[&](const ResourceView & v) {
+                f(v,decode(v,mr));
+            },pol,d);
+        }
+
+        /** The walk of try_decode() without the decoding: f(view)
+            gets called for every selected block which passes its
+            validator. For containers decoding the views themselves.
+         */
+
+        template<class F>
+        ParseStatus try_select(const Byte_t * p,size_t n,F f,ParsePolicy_t pol=Strict,ParseDiagnostics * d=NULL) const {
+            ParseStatus bad;
+
+            ParseStatus s = ResourceBlocks(p,n).for_each([&](const ResourceView & v) {
+                ResourceId::Enum_t e = v.get_id().to_enum();
+
+                if(!_sel[e])
+                    return true;
+
+                ParseStatus vs = validate(v);
+
+                if(!vs) {
+                    vs = vs.shift(v.get_raw()-p);
+                    if(d!=NULL)
+                        d->add(vs);
+                    if(bad.ok())
+                        bad = vs;
+                    return pol==Resync;
+                }
+
+                f(v);
+                return true;
+            },pol,d);
+
+            if(s.ok() || (!bad.ok() && bad.get_offset()<s.get_offset()))
+                return bad;
+            return s;
+        }
+
+        /** The registry as it comes out of the box
+         */
+
+        static const ResourceDecoder & Default() {
+            static const ResourceDecoder d;
+            return d;
+        }
+
+    private:
+        static int check(ResourceId::Enum_t e) {
+            if(e<0 || e>=ResourceId::EnumCount)
+                throw std::runtime_error("illegal ResourceId enum");
+            return e;
+        }
+
+        Decode_t   _f[ResourceId::EnumCount];
+        Validate_t _v[ResourceId::EnumCount];
+        bool       _sel[ResourceId::EnumCount];
+    };
+}
+
+#endif // PSTIFF_RESOURCEDECODER_H
@@ -23,9 +23,11 @@
 
 #include "pstiff/Types.h"
 
-#include <map>
 #include <string>
-#include <sstream>
+#include <ostream>
+#include <stdexcept>
+
+#include <stddef.h>
 
 namespace PsTiff {
     class ResourceId {
@@ -67,6 +69,17 @@ namespace PsTiff {
             PrintInformation,
             PrintStyle
         };
+        /** Number of entries in Enum_t
+         */
+
+        static const int EnumCount = PrintStyle + 1;
+
+        /** Lowest and highest Image Resource Id we know about
+         */
+
+        static const int IdMin = 1000;
+        static const int IdMax = 10000;
+
         struct Range_t {
             int from;
             int to;
@@ -74,16 +87,6 @@ namespace PsTiff {
             operator const void * () const {
                return (from==-1 || to==-1 ? NULL : this);
             }
-
-            bool operator<(const Range_t &r) const {
-                if(from>to || r.from>r.to)
-                {
-                    std::stringstream ss;
-                    ss << " illegal range pair [" << from << ";" << to << "] and [" << r.from << ";" << r.to << "]";
-                    throw std::runtime_error(ss.str());
-                }
-                return to<r.from;
-            }
         };
     private:
 
@@ -97,84 +100,66 @@ namespace PsTiff {
             const char *name;
         };
 
-        class Map_t {
-        private:
-            typedef std::map<Range_t,Enum_t>       FMap_t;
-            typedef std::map<Enum_t,Range_t>       BMap_t;
-        public:
-
-            typedef FMap_t::const_iterator const_iterator;
-            typedef BMap_t::const_iterator b_const_iterator;
-
-            void clear() {
-                _f.clear();
-                _b.clear();
-            }
-
-
-            bool empty() const {
-                return _f.empty() && _b.empty();
-            }
-
-            const_iterator find(int n) const {
-                Range_t r {n,n};
-                return _f.find(r);
-            }
-
-            const_iterator end() const {
-                return _f.end();
-            }
+        /** Direct index table [IdMin;IdMax] => Enum_t. Ranges like
+            PathInformation [2000;2997] and PluginResources [4000;4999]
+            are unrolled at compile time.
+         */
 
-            b_const_iterator b_find(Enum_t e) const {
-                return _b.find(e);
-            }
+        struct Table_t {
+            unsigned char e[IdMax - IdMin + 1];
+        };
 
-            b_const_iterator b_end() const {
-                return _b.end();
-            }
+        /** Enum_t => Range_t
+         */
 
-            FMap_t::mapped_type & operator[](const Range_t & r ) {
-                return _f[r];
-            }
+        struct RangeTable_t {
+            Range_t r[EnumCount];
+        };
 
-            BMap_t::mapped_type & operator[](const Enum_t & e ) {
-                return _b[e];
-            }
+        /** Enum_t => Name
+         */
 
-            private:
-                FMap_t _f;
-                BMap_t _b;
+        struct NameTable_t {
+            const char * n[EnumCount];
         };
 
-        typedef std::map<Enum_t,std::string>   Names_t;
-
-        template<class NODE,int N>
-        static void BuildNames(const NODE (&a)[N], Names_t & n)
-        {
-            n.clear();
-            for(int i=0;i<N;i++) {
-                n[ a[i].e ] = a[i].name;
+        template<size_t N>
+        static constexpr Table_t BuildTable(const Node_t (&a)[N]) {
+            Table_t t {};
+            for(int i=0;i<IdMax-IdMin+1;i++)
+                t.e[i] = Unknown;
+            for(size_t i=0;i<N;i++) {
+                if(a[i]._r.from>a[i]._r.to || a[i]._r.from<IdMin || a[i]._r.to>IdMax)
+                    throw std::logic_error("illegal ImageResourceId range");
+                for(int n=a[i]._r.from;n<=a[i]._r.to;n++)
+                    t.e[n-IdMin] = a[i]._e;
             }
+            return t;
         }
 
-        template<int N>
-        static void BuildMap( const Node_t (&a)[N] , Map_t &m)
-        {
-            m.clear();
-            for(int i=0;i<N;i++) {
-                if(a[i]._r.from>a[i]._r.to)
-                {
-                    std::stringstream ss;
-                    ss << "illegal ImageResourceId range " << a[i]._r.from << "-" << a[i]._r.to;
-                    throw std::runtime_error(ss.str());
-                }
-                m[ a[i]._r ] = a[i]._e;
-                m[ a[i]._e ] = a[i]._r;
-            }
+        template<size_t N>
+        static constexpr RangeTable_t BuildRanges(const Node_t (&a)[N]) {
+            RangeTable_t t {};
+            for(int i=0;i<EnumCount;i++)
+                t.r[i] = Range_t{-1,-1};
+            for(size_t i=0;i<N;i++)
+                t.r[a[i]._e] = a[i]._r;
+            return t;
         }
 
-        static const Map_t   & GetMap();
-        static const Names_t & GetNames();
+        template<size_t N>
+        static constexpr NameTable_t BuildNames(const NameNode_t (&a)[N]) {
+            NameTable_t t {};
+            for(size_t i=0;i<N;i++)
+                t.n[a[i].e] = a[i].name;
+            return t;
+        }
+
+        static const Node_t       _nodes[];
+        static const NameNode_t   _name_nodes[];
+        static const Table_t      _table;
+        static const RangeTable_t _ranges;
+        static const NameTable_t  _names;
 
     public:
         ResourceId(int n)
@@ -186,29 +171,44 @@ namespace PsTiff {
             return _e;
         }
 
-        static Enum_t to_enum(int n) {
-            Map_t::const_iterator i=GetMap().find(n);
+        int to_int() const {
+            return _n;
+        }
 
-            if(i==GetMap().end())
-            {
+        static Enum_t to_enum(int n) {
+            if(n<IdMin || n>IdMax)
                 return Unknown;
-            }
-            return (*i).second;
+            return (Enum_t)_table.e[n-IdMin];
         }
 
         static Range_t to_range(const Enum_t & e) {
-            Map_t::b_const_iterator i=GetMap().b_find(e);
-            if(i==GetMap().b_end())
-            {
-                return Range_t();
-            }
-            return (*i).second;
+            if(e<0 || e>=EnumCount)
+                return Range_t{-1,-1};
+            return _ranges.r[e];
         }
 
         Range_t to_range() const {
             return to_range(_e);
         }
 
+        /** Name of the enum; never NULL and never allocates.
+         */
+
+        static const char * to_name(const Enum_t & e) {
+            if(e<0 || e>=EnumCount || _names.n[e]==NULL)
+                return "Unknown";
+            return _names.n[e];
+        }
+
+        const char * get_name() const {
+            return to_name(_e);
+        }
+
+        /** Reverse of to_name(). Unknown if there is no such name.
+         */
+
+        static Enum_t from_name(const std::string & n);
+
         bool operator==(const Enum_t & e) const {
             return to_enum()==e;
         }
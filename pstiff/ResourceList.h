@@ -23,32 +23,91 @@
 
 #include "tiffio.h"
 #include <pstiff/Resource.h>
-#include <memory.h>
+#include <pstiff/ResourceDecoder.h>
+
+#include <memory>
+#include <string>
+#include <memory_resource>
+#include <vector>
 
 namespace PsTiff {
+
+    /**
+     * @brief The ResourceList class
+     *
+     * The sequence of Resources kept in the TIFFTAG_PHOTOSHOP tag.
+     */
+
     class ResourceList {
     private:
         typedef Resource resource_t;
-        typedef std::vector<const resource_t *> vector_t;
+        typedef std::shared_ptr<const resource_t> entry_t;
+        typedef std::pmr::vector<entry_t> vector_t;
 
     public:
         typedef vector_t::const_iterator        const_iterator;
-        ResourceList() : _p(NULL) {
 
+        /** Lists own their entries. The entries are immutable and
+            shared between copies of the list, so copying a list is
+            cheap and copies may be handed to other threads. Modified
+            resources get encoded when they're added, so reading an
+            entry never writes to it.
+
+            Everything read() allocates comes from mr. A list
+            copied from one living in an arena only shares the entries,
+            so it must not outlive the arena either.
+         */
+
+        explicit
+        ResourceList(Memory_t * mr=std::pmr::get_default_resource()) : _raw(mr),_v(mr) {
+        }
+
+        Memory_t * get_memory_resource() const {
+            return _v.get_allocator().resource();
         }
 
-        ~ResourceList() {
-            delete[] _p;
+        /** Add a copy of r. The copy shares the blob of r.
+         */
+
+        void add(const resource_t & r) {
+            _v.push_back(settle(entry_t(r.clone())));
+        }
+
+        void add(std::unique_ptr<resource_t> rp) {
+            if(rp)
+                _v.push_back(settle(entry_t(std::move(rp))));
         }
 
-        void add(const resource_t *rp) {
-            _v.push_back(rp);
+        /** Add rp itself; it must not be modified any more
+         */
+
+        void add(const entry_t & rp) {
+            if(rp)
+                _v.push_back(settle(rp));
+        }
+
+        /** Replace the entry at idx, e.g. by a modified copy of it
+         */
+
+        void set(size_t idx,const entry_t & rp) {
+            _v.at(idx) = settle(rp);
+        }
+
+        void clear() {
+            _v.clear();
         }
 
         size_t size() const {
             return _v.size();
         }
 
+        const resource_t & operator[](size_t idx) const {
+            return *_v.at(idx);
+        }
+
+        /** Exact number of bytes of the serialized list
+         */
+
         int get_size() const {
             int s=0;
             for(vector_t::const_iterator i=_v.begin();i!=_v.end();i++) {
@@ -57,21 +116,25 @@ namespace PsTiff {
             return s;
         }
 
-        const Byte_t * get_raw() {
-            delete[] _p;
-            int s = get_size();
-            int s1=0;
-            Byte_t *pp = _p = new Byte_t[s];
-
-            ::memset(_p,0,s);
+        /** Serialize all Resources into p which has to provide
+            get_size() bytes. Returns the first byte behind the list.
+         */
 
+        Byte_t * encode(Byte_t * p) const {
             for(vector_t::const_iterator i=_v.begin();i!=_v.end();i++) {
-                ::memcpy(pp,(*i)->get_raw(),(*i)->get_size());
-                pp += (*i)->get_size();
-                s1+=(*i)->get_size();
+                p = (*i)->encode(p);
             }
+            return p;
+        }
+
+        /** The serialized list. The buffer is owned by the list and
+            gets reused by the next call.
+         */
 
-            return _p;
+        const Byte_t * get_raw() {
+            _raw.resize(get_size());
+            encode(_raw.data());
+            return _raw.data();
         }
 
         const_iterator begin() const  {
@@ -82,15 +145,115 @@ namespace PsTiff {
             return _v.end();
         }
 
-        bool read(const std::string & path);
+        /** Read the Resources of the first directory of the TIFF file
+            at path. Returns false if the file can't be opened or has no
+            TIFFTAG_PHOTOSHOP tag.
+         */
+
+        bool read(const std::string & path,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Write the Resources into the current directory of the TIFF
+            file at path which gets rewritten in place. A classic TIFF
+            can't become a BigTIFF this way; this fails if it would
+            grow past 4 GB.
+         */
+
         bool write(const std::string & path);
 
-        bool read(TIFF * in);
+        /** Copy the TIFF file at from to to, with the Resources in the
+            first directory replaced by this list. Strips and tiles are
+            copied raw, see TiffCopy; all other directories and tags
+            stay as they are. The copy is written as a BigTIFF if it
+            could outgrow a classic TIFF.
+         */
+
+        bool write(const std::string & from,const std::string & to);
+
+        /** Read the Resources of the current directory of in
+         */
+
+        bool read(TIFF * in,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Set the TIFFTAG_PHOTOSHOP tag of the current directory of out.
+            Writing the directory is left to the caller.
+         */
+
         bool write(TIFF * out);
 
+        /** Read the Resources of the first directory of the TIFF file
+            kept in tiff[n]. No temporary file gets involved.
+         */
+
+        bool read_tiff(const Byte_t * tiff,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Read the Image Resources section of the PSD or PSB file at
+            path, see PsdReader. Returns false if the file can't be
+            opened or is no PSD file.
+         */
+
+        bool read_psd(const std::string & path,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Read the Image Resources section of the PSD or PSB file
+            kept in psd[n]
+         */
+
+        bool read_psd(const Byte_t * psd,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Read the Photoshop resources kept in the APP13 segments of
+            the JPEG file at path, see JpegReader. Returns false if the
+            file can't be opened or is no JPEG file.
+         */
+
+        bool read_jpeg(const std::string & path,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Read the Photoshop resources of the JPEG file kept in
+            jpeg[n]
+         */
+
+        bool read_jpeg(const Byte_t * jpeg,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Rewrite the first directory of the TIFF file kept in tiff
+            with the Resources of this list. The vector grows by the
+            rewritten directory.
+         */
+
+        bool write_tiff(std::vector<Byte_t> & tiff);
+
+        /** Decode the Photoshop resource blob p[n]. The blob gets
+            copied once into a buffer shared by all Resources.
+         */
+
+        void read(const Byte_t * p,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Decode the blob b[n] without copying it; the Resources
+            share the ownership of b.
+         */
+
+        void read(const Buffer_t & b,size_t n,const ResourceDecoder & d=ResourceDecoder::Default());
+
+        /** Non throwing versions of read(). Malformed blocks are
+            handled according to pol and recorded in diag; the blocks
+            read so far stay in the list. Returns the first error.
+         */
+
+        ParseStatus try_read(const Byte_t * p,size_t n,const ResourceDecoder & d=ResourceDecoder::Default(),
+                             ParsePolicy_t pol=Strict,ParseDiagnostics * diag=NULL);
+
+        ParseStatus try_read(const Buffer_t & b,size_t n,const ResourceDecoder & d=ResourceDecoder::Default(),
+                             ParsePolicy_t pol=Strict,ParseDiagnostics * diag=NULL);
+
     private:
-        Byte_t * _p;
-        vector_t _v;
+        /** Encode e now if it has been modified, see get_raw()
+         */
+
+        static const entry_t & settle(const entry_t & e) {
+            if(e)
+                e->get_raw();
+            return e;
+        }
+
+        std::pmr::vector<Byte_t> _raw;  //< serialized list as handed out by get_raw()
+        vector_t                 _v;
     };
 }
 #endif  // PSTIFF_RESOURCELIST_H
@@ -0,0 +1,327 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_RESOURCEVIEW_H
+#define PSTIFF_RESOURCEVIEW_H
+
+#include "pstiff/ResourceId.h"
+#include "pstiff/ParseStatus.h"
+
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <sstream>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace PsTiff {
+
+    /**
+     * @brief The ResourceView class
+     *
+     * Non owning view of a single '8BIM'<ID><M>string[M]<N>data[N]
+     * block. Only the position of the block and a couple of offsets
+     * are kept, the bytes stay wherever the caller (usually the TIFFLib)
+     * keeps them and have to outlive the view.
+     */
+
+    class ResourceView {
+    public:
+        ResourceView() : _p(NULL),_size(0),_id(0),_doff(0) {
+        }
+
+        /** Parse the block header at p. n is the number of bytes
+            available from p on. The default trusts the caller.
+            Throws if the header is malformed.
+         */
+
+        explicit
+        ResourceView(const Byte_t * p,size_t n=SIZE_MAX) : _p(NULL),_size(0),_id(0),_doff(0) {
+            parse(p,n,*this).check();
+        }
+
+        /** Non throwing version of the constructor. v is only
+            assigned if the header is fine; the offset of a failed
+            status is relative to p.
+         */
+
+        static ParseStatus parse(const Byte_t * p,size_t n,ResourceView & v) noexcept {
+            if(n<4 || ::memcmp(p,"8BIM",4)!=0)
+                return ParseStatus(ParseStatus::BadSignature,0);
+
+            if(n<7)
+                return ParseStatus(ParseStatus::TruncatedHeader,n);
+
+            uint16_t doff = (uint16_t)(6 + get_padded_name_size(p[6]));
+
+            if(n < (size_t)doff + sizeof(uint32_t))
+                return ParseStatus(ParseStatus::TruncatedHeader,n);
+
+            uint32_t size = to32(p + doff);
+
+            doff += sizeof(uint32_t);
+
+            if(n - doff < size)
+                return ParseStatus(ParseStatus::TruncatedData,doff);
+
+            v._p    = p;
+            v._id   = to16(p + 4);
+            v._doff = doff;
+            v._size = size;
+
+            return ParseStatus();
+        }
+
+        /** Size of the length prefixed name padded to an even number of bytes
+         */
+
+        static size_t get_padded_name_size(size_t l) {
+            return (l & 0x1) ? l + 1 : l + 2;
+        }
+
+        /** Size of the block header for a name of length l
+         */
+
+        static size_t get_header_size(size_t l) {
+            return 4 + sizeof(uint16_t) + get_padded_name_size(l) + sizeof(uint32_t);
+        }
+
+        const Byte_t * get_raw() const {
+            return _p;
+        }
+
+        uint16_t get_id_value() const {
+            return _id;
+        }
+
+        ResourceId get_id() const {
+            return ResourceId(_id);
+        }
+
+        const char * get_name_data() const {
+            return (const char *)_p + 7;
+        }
+
+        size_t get_name_length() const {
+            return _p==NULL ? 0 : _p[6];
+        }
+
+        std::string_view get_name() const {
+            return std::string_view(get_name_data(),get_name_length());
+        }
+
+        const Byte_t * get_data() const {
+            return _p==NULL ? NULL : _p + _doff;
+        }
+
+        uint32_t get_data_size() const {
+            return _size;
+        }
+
+        /** Offset of the data relative to get_raw()
+         */
+
+        uint16_t get_data_offset() const {
+            return _doff;
+        }
+
+        /** Size of the whole block including the padding of the data
+            to an even number of bytes.
+         */
+
+        uint32_t get_size() const {
+            return _p==NULL ? 0 : _doff + _size + (_size & 0x1);
+        }
+
+    private:
+        friend class Resource;
+
+        /** View of a block whose header has been checked before
+         */
+
+        ResourceView(const Byte_t * p,uint16_t id,uint16_t doff,uint32_t size)
+            : _p(p),_size(size),_id(id),_doff(doff) {
+        }
+
+        const Byte_t * _p;
+        uint32_t       _size;
+        uint16_t       _id;
+        uint16_t       _doff;
+    };
+
+    /**
+     * @brief The ResourceBlocks class
+     *
+     * Walks a Photoshop resource blob (e.g. the content of the
+     * TIFFTAG_PHOTOSHOP tag) block by block and hands out ResourceViews.
+     * Nothing gets copied, every header gets parsed exactly once.
+     */
+
+    class ResourceBlocks {
+    public:
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef ResourceView              value_type;
+            typedef std::ptrdiff_t            difference_type;
+            typedef const ResourceView *      pointer;
+            typedef const ResourceView &      reference;
+
+            const_iterator() : _p(NULL),_e(NULL) {
+            }
+
+            const_iterator(const Byte_t *p,const Byte_t *e) : _p(p),_e(e) {
+                parse();
+            }
+
+            reference operator*() const {
+                return _v;
+            }
+
+            pointer operator->() const {
+                return &_v;
+            }
+
+            const_iterator & operator++() {
+                size_t s = _v.get_size();
+                // The padding of the last block may be missing
+                _p += s < (size_t)(_e - _p) ? s : (size_t)(_e - _p);
+                parse();
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator i(*this);
+                ++(*this);
+                return i;
+            }
+
+            bool operator==(const const_iterator & i) const {
+                return _p==i._p;
+            }
+
+            bool operator!=(const const_iterator & i) const {
+                return _p!=i._p;
+            }
+
+            /** Position of the current block within the blob
+             */
+
+            const Byte_t * get_pos() const {
+                return _p;
+            }
+
+        private:
+            void parse() {
+                _v = _p<_e ? ResourceView(_p,_e-_p) : ResourceView();
+            }
+
+            const Byte_t * _p;
+            const Byte_t * _e;
+            ResourceView   _v;
+        };
+
+        ResourceBlocks(const Byte_t * p,size_t n) : _p(p),_n(n) {
+        }
+
+        const_iterator begin() const {
+            return const_iterator(_p,_p+_n);
+        }
+
+        const_iterator end() const {
+            return const_iterator(_p+_n,_p+_n);
+        }
+
+        /** Non throwing walk calling f(view) for every block; f
+            returns false to stop the walk. With Strict the walk stops
+            at the first malformed block, with Resync the block is
+            skipped up to the next '8BIM'. Errors are added to d if
+            given, their offsets are relative to the start of the blob.
+            Returns the first error or Ok.
+         */
+
+        template<class F>
+        ParseStatus for_each(F f,ParsePolicy_t pol=Strict,ParseDiagnostics * d=NULL) const {
+            ParseStatus    first;
+            const Byte_t * p = _p;
+            const Byte_t * e = _p + _n;
+
+            while(p<e) {
+                ResourceView v;
+                ParseStatus  s = ResourceView::parse(p,e-p,v);
+
+                if(s) {
+                    if(!f(v))
+                        break;
+                    size_t l = v.get_size();
+                    // The padding of the last block may be missing
+                    p += l < (size_t)(e - p) ? l : (size_t)(e - p);
+                    continue;
+                }
+
+                s = s.shift(p-_p);
+
+                if(d!=NULL)
+                    d->add(s);
+
+                if(first.ok())
+                    first = s;
+
+                if(pol==Strict)
+                    break;
+
+                p = find_signature(p+1,e);
+            }
+
+            return first;
+        }
+
+        /** First '8BIM' within [p;e) or e
+         */
+
+        static const Byte_t * find_signature(const Byte_t * p,const Byte_t * e) {
+            while(e-p>=4) {
+                const Byte_t * q = (const Byte_t *)::memchr(p,'8',e-p-3);
+                if(q==NULL)
+                    break;
+                if(::memcmp(q,"8BIM",4)==0)
+                    return q;
+                p = q+1;
+            }
+            return e;
+        }
+
+        const Byte_t * get_raw() const {
+            return _p;
+        }
+
+        size_t get_size() const {
+            return _n;
+        }
+
+    private:
+        const Byte_t * _p;
+        size_t         _n;
+    };
+}
+
+#endif // PSTIFF_RESOURCEVIEW_H
@@ -0,0 +1,90 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TIFFCOPY_H
+#define PSTIFF_TIFFCOPY_H
+
+#include "tiffio.h"
+#include <pstiff/Types.h>
+#include <pstiff/TiffFormat.h>
+
+#include <functional>
+
+namespace PsTiff {
+
+    class ResourceList;
+
+    /**
+     * @brief The TiffCopy class
+     *
+     * Copies directories from one libtiff handle to another without
+     * decoding the image: strips and tiles are moved as they are with
+     * TIFFReadRawStrip/TIFFWriteRawStrip (resp. the tile versions),
+     * so the pixels stay bit identical and no codec gets to run.
+     *
+     * The tags libtiff knows of get copied by type, all others as the
+     * anonymous fields libtiff reads them into. Only the Photoshop
+     * tag can be replaced, by the Resources of a ResourceList written
+     * with ResourceList::write(TIFF *). SubIFDs are not followed.
+     */
+
+    class TiffCopy {
+    public:
+        /** Hands out the Resources for page, NULL keeps the page's
+            original Photoshop tag.
+         */
+
+        typedef std::function<ResourceList *(size_t page)> Resources_t;
+
+        /** Copy the tags of the current directory of in to out; the
+            Photoshop tag only if photoshop is set.
+         */
+
+        static bool copy_tags(TIFF * in,TIFF * out,bool photoshop=true);
+
+        /** Copy the strips or tiles of the current directory of in to
+            out, whose tags have to describe the same layout.
+         */
+
+        static bool copy_data(TIFF * in,TIFF * out);
+
+        /** Copy the current directory of in to out, with the Resources
+            of l as Photoshop tag if l is not NULL. Writing the
+            directory is left to the caller.
+         */
+
+        static bool copy_directory(TIFF * in,TIFF * out,ResourceList * l=NULL);
+
+        /** Copy all directories of in, starting with the current one,
+            each into a directory of its own in out.
+         */
+
+        static bool copy(TIFF * in,TIFF * out,const Resources_t & f=Resources_t());
+
+        /** TIFFOpen() mode for writing a file of about size bytes:
+            "w" for a classic TIFF, "w8" for a BigTIFF once size gets
+            past what 32 bit offsets can address.
+         */
+
+        static const char * get_write_mode(uint64_t size);
+    };
+}
+
+#endif // PSTIFF_TIFFCOPY_H
@@ -0,0 +1,247 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TIFFFORMAT_H
+#define PSTIFF_TIFFFORMAT_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+
+#include <string.h>
+
+namespace PsTiff {
+
+    /**
+     * @brief The TiffFormat class
+     *
+     * Byte order and layout of a classic TIFF or a BigTIFF file. The
+     * two differ in the width of everything that may grow with the
+     * file:
+     *
+     *                      classic   BigTIFF
+     *   header                   8        16
+     *   entry count              2         8
+     *   directory entry         12        20
+     *   offsets, value counts    4         8   ("words" below)
+     *
+     * A payload of up to one word is kept inside its directory entry.
+     */
+
+    class TiffFormat {
+    public:
+        /** Largest offset a classic TIFF can hold
+         */
+
+        static const uint64_t ClassicLimit = UINT32_MAX;
+
+        /** Bytes needed to tell classic TIFF from BigTIFF
+         */
+
+        static const size_t MinHeaderSize = 8;
+
+        TiffFormat(bool le=true,bool big=false) : _le(le),_big(big) {
+        }
+
+        /** Check the header p[n] and set the format accordingly; first
+            gets the offset of the first directory. A BigTIFF header
+            needs n>=16, see get_header_size(p).
+         */
+
+        ParseStatus read_header(const Byte_t * p,size_t n,uint64_t & first) {
+            if(p==NULL || n<MinHeaderSize)
+                return ParseStatus(ParseStatus::BadTiffHeader,0);
+
+            if(::memcmp(p,"II",2)==0)
+                _le = true;
+            else if(::memcmp(p,"MM",2)==0)
+                _le = false;
+            else
+                return ParseStatus(ParseStatus::BadTiffHeader,0);
+
+            switch(get16(p+2)) {
+            case 42:
+                _big  = false;
+                first = get32(p+4);
+                break;
+            case 43:
+                // Offset size 8, always followed by a 0
+
+                if(n<16 || get16(p+4)!=8 || get16(p+6)!=0)
+                    return ParseStatus(ParseStatus::BadTiffHeader,4);
+
+                _big  = true;
+                first = get64(p+8);
+                break;
+            default:
+                return ParseStatus(ParseStatus::BadTiffHeader,2);
+            }
+
+            if(first<get_header_size())
+                return ParseStatus(ParseStatus::BadDirectory,get_first_link());
+
+            return ParseStatus();
+        }
+
+        /** Size of the header starting with the 8 bytes at p, i.e.
+            16 for a BigTIFF and 8 for anything else
+         */
+
+        static size_t get_header_size(const Byte_t * p) {
+            return (p[2]==43 && p[3]==0) || (p[2]==0 && p[3]==43) ? 16 : 8;
+        }
+
+        bool is_little_endian() const {
+            return _le;
+        }
+
+        bool is_big() const {
+            return _big;
+        }
+
+        size_t get_header_size() const {
+            return _big ? 16 : 8;
+        }
+
+        /** Offset of the header field pointing to the first directory
+         */
+
+        uint64_t get_first_link() const {
+            return _big ? 8 : 4;
+        }
+
+        size_t get_count_size() const {
+            return _big ? 8 : 2;
+        }
+
+        size_t get_entry_size() const {
+            return _big ? 20 : 12;
+        }
+
+        size_t get_word_size() const {
+            return _big ? 8 : 4;
+        }
+
+        /** Largest offset the format can hold
+         */
+
+        uint64_t get_limit() const {
+            return _big ? UINT64_MAX : ClassicLimit;
+        }
+
+        /** Size of a directory of n entries, including the entry count
+            and the offset of the next directory
+         */
+
+        uint64_t get_directory_size(uint64_t n) const {
+            return get_count_size() + n * get_entry_size() + get_word_size();
+        }
+
+        uint16_t get16(const Byte_t * p) const {
+            return _le ? (uint16_t)(p[0] | p[1] << 8) : to16(p);
+        }
+
+        uint32_t get32(const Byte_t * p) const {
+            return _le ? (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24
+                       : to32(p);
+        }
+
+        uint64_t get64(const Byte_t * p) const {
+            uint64_t a = get32(p);
+            uint64_t b = get32(p+4);
+            return _le ? a | b << 32 : a << 32 | b;
+        }
+
+        /** The number of entries of the directory starting at p
+         */
+
+        uint64_t get_count(const Byte_t * p) const {
+            return _big ? get64(p) : get16(p);
+        }
+
+        /** An offset or value count
+         */
+
+        uint64_t get_word(const Byte_t * p) const {
+            return _big ? get64(p) : get32(p);
+        }
+
+        Byte_t * put16(Byte_t * p,uint16_t v) const {
+            if(!_le)
+                return from16(p,v);
+
+            p[0] = v;
+            p[1] = v >> 8;
+
+            return p+2;
+        }
+
+        Byte_t * put32(Byte_t * p,uint32_t v) const {
+            if(!_le)
+                return from32(p,v);
+
+            p[0] = v;
+            p[1] = v >> 8;
+            p[2] = v >> 16;
+            p[3] = v >> 24;
+
+            return p+4;
+        }
+
+        Byte_t * put64(Byte_t * p,uint64_t v) const {
+            return _le ? put32(put32(p,v),v >> 32) : put32(put32(p,v >> 32),v);
+        }
+
+        Byte_t * put_count(Byte_t * p,uint64_t v) const {
+            return _big ? put64(p,v) : put16(p,v);
+        }
+
+        Byte_t * put_word(Byte_t * p,uint64_t v) const {
+            return _big ? put64(p,v) : put32(p,v);
+        }
+
+        /** Entry e: tag, type, value count and the payload or its offset
+         */
+
+        uint16_t get_tag(const Byte_t * e) const {
+            return get16(e);
+        }
+
+        uint16_t get_type(const Byte_t * e) const {
+            return get16(e+2);
+        }
+
+        uint64_t get_value_count(const Byte_t * e) const {
+            return get_word(e+4);
+        }
+
+        /** Position of the payload or its offset within an entry
+         */
+
+        size_t get_value_pos() const {
+            return 4 + get_word_size();
+        }
+
+    private:
+        bool _le;
+        bool _big;
+    };
+}
+
+#endif // PSTIFF_TIFFFORMAT_H
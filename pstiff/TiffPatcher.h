@@ -0,0 +1,148 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TIFFPATCHER_H
+#define PSTIFF_TIFFPATCHER_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+#include <pstiff/TiffWalker.h>
+
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+
+    /**
+     * @brief The TiffPatcher class
+     *
+     * Changes a single tag of a TIFF or BigTIFF file in place, leaving
+     * everything else, strips and tiles in particular, untouched:
+     *
+     * - A payload which fits into the space of the old one overwrites
+     *   it and the directory entry gets its new count.
+     * - A bigger one gets appended to the file and the entry is
+     *   pointed to it. The old payload is left behind unreferenced.
+     * - If the directory has no such tag yet, the payload and a copy
+     *   of the directory with the new entry get appended, and the
+     *   header or the previous directory is relinked to the copy.
+     *
+     * A classic TIFF stays one, so appending fails with BadSize where
+     * it would take the file past 4 GB; see TiffCopy for rewriting it
+     * as a BigTIFF.
+     *
+     * Appended payloads and directories are written before the entry
+     * or link pointing to them, so an interrupted append leaves the
+     * old tag in effect. An overwrite in place has no such guarantee.
+     *
+     * Format problems are returned as ParseStatus; failing reads or
+     * writes throw a std::runtime_error.
+     */
+
+    class TiffPatcher {
+    public:
+        TiffPatcher() : _fd(-1),_size(0),_first(0) {
+        }
+
+        explicit
+        TiffPatcher(const std::string & path) : TiffPatcher() {
+            open(path);
+        }
+
+        TiffPatcher(const TiffPatcher &) = delete;
+        TiffPatcher & operator=(const TiffPatcher &) = delete;
+
+        ~TiffPatcher() {
+            close();
+        }
+
+        /** Open path for reading and writing and check its header.
+            Returns false if the file can't be opened; a bad header is
+            reported by get_status().
+         */
+
+        bool open(const std::string & path);
+
+        void close();
+
+        bool is_open() const {
+            return _fd>=0;
+        }
+
+        const ParseStatus & get_status() const {
+            return _st;
+        }
+
+        uint64_t get_size() const {
+            return _size;
+        }
+
+        const TiffFormat & get_format() const {
+            return _f;
+        }
+
+        /** Set tag of directory page to the n bytes at p, which have
+            to be a whole number of values of TIFF type type. They are
+            taken as is, i.e. in the byte order of the file. Empty
+            payloads are refused, TIFF has no use for them.
+         */
+
+        ParseStatus set_tag(size_t page,uint16_t tag,uint16_t type,const Byte_t * p,size_t n);
+
+        /** Set the Photoshop tag (34377) of directory page
+         */
+
+        ParseStatus set_photoshop(size_t page,const Byte_t * p,size_t n) {
+            return set_tag(page,TiffWalker::TagPhotoshop,1,p,n);
+        }
+
+        /** Set the Photoshop tag of directory page to the Resources
+            of a ResourceList or FlatResourceList
+         */
+
+        template<class L>
+        ParseStatus set_resources(size_t page,L & l) {
+            const Byte_t * p = l.get_raw();
+            return set_photoshop(page,p,l.get_size());
+        }
+
+    private:
+        struct Directory_t {
+            uint64_t            link;     //< where the offset of this directory is kept
+            uint64_t            offset;
+            uint64_t            count;
+            std::vector<Byte_t> entries;  //< count entries and the next offset
+        };
+
+        ParseStatus find(size_t page,Directory_t & d);
+        ParseStatus append(const Byte_t * p,size_t n,uint64_t & off);
+
+        void read(uint64_t off,void * p,size_t n);
+        void write(uint64_t off,const void * p,size_t n);
+
+        int         _fd;
+        TiffFormat  _f;
+        uint64_t    _size;
+        uint64_t    _first;
+        ParseStatus _st;
+    };
+}
+
+#endif // PSTIFF_TIFFPATCHER_H
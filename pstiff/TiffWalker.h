@@ -0,0 +1,179 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TIFFWALKER_H
+#define PSTIFF_TIFFWALKER_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+#include <pstiff/TiffFormat.h>
+
+#include <set>
+
+namespace PsTiff {
+
+    /**
+     * @brief The TiffWalker class
+     *
+     * Minimal reader for the header and the directory (IFD) chain of a
+     * little or big endian classic TIFF or BigTIFF kept in memory,
+     * usually a mapped file. Only the entries of the tags we care
+     * about get looked at; their payloads are handed out as spans into
+     * the blob, nothing is copied and no strip or tile arrays are read.
+     */
+
+    class TiffWalker {
+    public:
+        static const uint16_t TagXmp          = 700;
+        static const uint16_t TagPhotoshop    = 34377;
+        static const uint16_t TagPhotoshopDdb = 37724;
+
+        /** Upper bound for the number of directories we follow
+         */
+
+        static const size_t MaxDirectories = 65536;
+
+        /** A directory entry together with its payload
+         */
+
+        struct Tag_t {
+            Tag_t() : tag(0),type(0),count(0),entry(0),offset(0) {
+            }
+
+            bool empty() const {
+                return entry==0;
+            }
+
+            uint16_t tag;
+            uint16_t type;
+            uint64_t count;
+            uint64_t entry;   //< file offset of the directory entry
+            uint64_t offset;  //< file offset of the payload
+            Span_t   data;
+        };
+
+        struct Directory_t {
+            Directory_t() : index(0),offset(0),count(0),next(0) {
+            }
+
+            size_t   index;     //< 0 for the first page
+            uint64_t offset;    //< file offset of the directory
+            uint64_t count;     //< number of entries
+            uint64_t next;      //< offset of the next directory, 0 for the last one
+            Tag_t    photoshop;
+            Tag_t    xmp;
+            Tag_t    ddb;
+        };
+
+        /** Check the header of the TIFF blob p[n]. A failure is
+            reported by get_status().
+         */
+
+        TiffWalker(const Byte_t * p,size_t n);
+
+        TiffWalker(const Span_t & s) : TiffWalker(s.data(),s.size()) {
+        }
+
+        const ParseStatus & get_status() const {
+            return _st;
+        }
+
+        bool is_little_endian() const {
+            return _f.is_little_endian();
+        }
+
+        bool is_big() const {
+            return _f.is_big();
+        }
+
+        const TiffFormat & get_format() const {
+            return _f;
+        }
+
+        uint64_t get_first_offset() const {
+            return _first;
+        }
+
+        const Byte_t * get_raw() const {
+            return _p;
+        }
+
+        size_t get_size() const {
+            return _n;
+        }
+
+        /** Read the directory at off; d.next gets the offset of the
+            following one. d.index is left to the caller.
+         */
+
+        ParseStatus read_directory(uint64_t off,Directory_t & d) const;
+
+        /** Call f(dir) for every directory until f returns false.
+            Returns the first error, e.g. a directory outside the file
+            or a chain running in circles.
+         */
+
+        template<class F>
+        ParseStatus for_each(F f) const {
+            if(!_st)
+                return _st;
+
+            std::set<uint64_t> seen;
+            uint64_t           off = _first;
+
+            for(size_t i=0;off!=0 && i<MaxDirectories;i++) {
+                if(!seen.insert(off).second)
+                    return ParseStatus(ParseStatus::BadDirectory,off);
+
+                Directory_t d;
+                ParseStatus s = read_directory(off,d);
+
+                if(!s)
+                    return s;
+
+                d.index = i;
+
+                if(!f(static_cast<const Directory_t &>(d)))
+                    break;
+
+                off = d.next;
+            }
+
+            return ParseStatus();
+        }
+
+        /** Size of a single value of the TIFF field type t, 0 for
+            unknown types
+         */
+
+        static size_t get_type_size(uint16_t t);
+
+    private:
+        ParseStatus read_tag(const Byte_t * e,Tag_t & t) const;
+
+        const Byte_t * _p;
+        size_t         _n;
+        TiffFormat     _f;
+        uint64_t       _first;
+        ParseStatus    _st;
+    };
+}
+
+#endif // PSTIFF_TIFFWALKER_H
@@ -19,14 +19,73 @@
 //========================================================================
 
 #ifndef PSTIFF_TYPES_H
-#define TYPES_H
+#define PSTIFF_TYPES_H
 
 #include <stdint.h>
 #include <stdexcept>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include <string.h>
 
 namespace PsTiff {
     typedef unsigned char Byte_t;
 
+    /** Where Resources and Lists get their memory from
+     */
+
+    typedef std::pmr::memory_resource Memory_t;
+
+    /** Shared, immutable chunk of bytes
+     */
+
+    typedef std::shared_ptr<const Byte_t> Buffer_t;
+
+    /**
+     * @brief The Span_t struct
+     *
+     * Non owning pointer/length pair into some blob, e.g. the payload
+     * of a TIFF tag within a mapped file.
+     */
+
+    struct Span_t {
+        Span_t() : p(NULL),n(0) {
+        }
+
+        Span_t(const Byte_t * pp,size_t nn) : p(pp),n(nn) {
+        }
+
+        const Byte_t * data() const {
+            return p;
+        }
+
+        size_t size() const {
+            return n;
+        }
+
+        bool empty() const {
+            return p==NULL || n==0;
+        }
+
+        const Byte_t * p;
+        size_t         n;
+    };
+
+    /** Allocate a Buffer_t of n bytes from mr; p gets the writable
+        bytes. Bytes and bookkeeping both come from mr, so the buffer
+        must not outlive it.
+     */
+
+    inline
+    Buffer_t make_buffer(size_t n,Byte_t * & p,Memory_t * mr=std::pmr::get_default_resource()) {
+        size_t s = n==0 ? 1 : n;
+        p = static_cast<Byte_t *>(mr->allocate(s,1));
+        return Buffer_t(p,[mr,s](const Byte_t * b) { mr->deallocate(const_cast<Byte_t *>(b),s,1); },
+                        std::pmr::polymorphic_allocator<Byte_t>(mr));
+    }
+
     inline Byte_t  to8(const Byte_t *p) {
         return *p;
     }
@@ -38,35 +97,77 @@ namespace PsTiff {
     }
 
 
+    /** Everything Photoshop writes is big endian. Single values get
+        loaded unaligned and byte swapped on little endian hosts, which
+        compilers turn into a mov + bswap (or movbe).
+     */
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    inline uint16_t bswap16(uint16_t v) { return v; }
+    inline uint32_t bswap32(uint32_t v) { return v; }
+#elif defined(__GNUC__)
+    inline uint16_t bswap16(uint16_t v) { return __builtin_bswap16(v); }
+    inline uint32_t bswap32(uint32_t v) { return __builtin_bswap32(v); }
+#else
+    inline uint16_t bswap16(uint16_t v) {
+        const Byte_t * p = (const Byte_t *)&v;
+        return (uint16_t)p[0] << 8 | (uint16_t)p[1];
+    }
+    inline uint32_t bswap32(uint32_t v) {
+        const Byte_t * p = (const Byte_t *)&v;
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+               (uint32_t)p[2] <<  8 | (uint32_t)p[3] << 0;
+    }
+#endif
+
     inline
     uint16_t to16(const Byte_t * p) {
-        return (uint16_t)p[0] << 8 | (uint16_t)p[1];
+        uint16_t v;
+        ::memcpy(&v,p,sizeof(v));
+        return bswap16(v);
     }
 
     inline
     Byte_t * from16(Byte_t *p,uint16_t w) {
-        p[0] = (Byte_t)(w >> 8 & 0xff);
-        p[1] = (Byte_t)(w >> 0 & 0xff);
+        w = bswap16(w);
+        ::memcpy(p,&w,sizeof(w));
         return p+2;
     }
 
     inline
     uint32_t to32(const Byte_t * p) {
-        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
-               (uint32_t)p[2] << 16 | (uint32_t)p[3] << 0;
+        uint32_t v;
+        ::memcpy(&v,p,sizeof(v));
+        return bswap32(v);
     }
 
     inline
     Byte_t * from32(Byte_t *p,uint32_t ww) {
-        p[0] = (Byte_t)(ww >> 24 & 0xff);
-        p[1] = (Byte_t)(ww >> 16 & 0xff);
-        p[2] = (Byte_t)(ww >>  8 & 0xff);
-        p[3] = (Byte_t)(ww >>  0 & 0xff);
+        ww = bswap32(ww);
+        ::memcpy(p,&ww,sizeof(ww));
         return p+4;
     }
 
+    /** Bulk versions of to16/to32 and from16/from32 for n consecutive
+        values. The SSSE3 or AVX2 implementation gets picked at runtime
+        if the CPU has it, a scalar loop otherwise. Source and
+        destination must not overlap.
+     */
+
+    void decode16(uint16_t * d,const Byte_t * s,size_t n);
+    void decode32(uint32_t * d,const Byte_t * s,size_t n);
+
+    Byte_t * encode16(Byte_t * d,const uint16_t * s,size_t n);
+    Byte_t * encode32(Byte_t * d,const uint32_t * s,size_t n);
+
+    /** Name of the implementation picked for the bulk kernels
+        ("avx2", "ssse3" or "scalar")
+     */
+
+    const char * get_kernel_name();
+
     inline
-    Byte_t * fromstr(Byte_t * p,const std::string & s) {
+    Byte_t * fromstr(Byte_t * p,std::string_view s) {
         p[0] = (Byte_t) s.length();
         for(int i=0;i<s.length();i++)
             p[1+i] = s[i];
@@ -0,0 +1,134 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_BATCH_SCANNER_H
+#define PSTIFF_IO_BATCH_SCANNER_H
+
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The BatchScanner class
+         *
+         * Pulls the Photoshop blocks (tag 34377) out of many TIFF or
+         * BigTIFF files at once. Every file runs through the header, its
+         * directories and the tag payloads with one read at a time;
+         * it's the many files in flight which keep the disk busy.
+         *
+         * Reads go through an io_uring (raw syscalls, no liburing)
+         * driven by the calling thread. Where the kernel refuses to
+         * set one up a pool of threads doing blocking pread() takes
+         * over. Either way complete payloads are queued to a pool of
+         * workers which call the callback, so the callback has to be
+         * thread safe.
+         */
+
+        class BatchScanner {
+        public:
+            typedef enum {
+                Auto,
+                Uring,
+                Threads
+            } Backend_t;
+
+            struct Options_t {
+                Options_t();
+
+                Backend_t backend;
+                unsigned  depth;       //< files in flight on the ring
+                unsigned  io_threads;  //< files in flight without a ring
+                unsigned  workers;     //< threads calling the callback
+                size_t    read_size;   //< size of the header and directory reads
+                size_t    queue_size;  //< payloads waiting for a worker before reads stall
+            };
+
+            /** A Photoshop block found in page page of file file, or,
+                with a non zero error or a failed status, the reason
+                why file could not be read to its end.
+             */
+
+            struct Item_t {
+                Item_t() : file(0),page(0),error(0),path(NULL) {
+                }
+
+                size_t              file;    //< index into the list handed to scan()
+                size_t              page;
+                int                 error;   //< errno of a failed open or read
+                ParseStatus         status;
+                const std::string * path;
+                std::vector<Byte_t> data;
+            };
+
+            struct Stats_t {
+                Stats_t() : files(0),failed(0),requests(0),bytes(0),payloads(0) {
+                }
+
+                uint64_t files;
+                uint64_t failed;
+                uint64_t requests;
+                uint64_t bytes;
+                uint64_t payloads;
+            };
+
+            typedef std::function<void(const Item_t &)> Callback_t;
+
+            explicit
+            BatchScanner(const Options_t & o=Options_t()) : _o(o),_uring(false) {
+            }
+
+            /** Scan all files in paths, calling f for every Photoshop
+                block and every failure. Returns once all callbacks
+                are done.
+             */
+
+            const Stats_t & scan(const std::vector<std::string> & paths,Callback_t f);
+
+            /** True if the last scan() ran on an io_uring
+             */
+
+            bool is_uring() const {
+                return _uring;
+            }
+
+            const Stats_t & get_stats() const {
+                return _stats;
+            }
+
+            /** Whether this kernel lets us set up an io_uring
+             */
+
+            static bool has_uring();
+
+        private:
+            Options_t _o;
+            Stats_t   _stats;
+            bool      _uring;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_BATCH_SCANNER_H
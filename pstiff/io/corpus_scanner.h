@@ -0,0 +1,148 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_CORPUS_SCANNER_H
+#define PSTIFF_IO_CORPUS_SCANNER_H
+
+#include <pstiff/Types.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The CorpusScanner class
+         *
+         * Runs a callback on every file of a collection of files,
+         * directories and lists of paths, many files at once, and
+         * hands the results on in input order.
+         *
+         * The inputs get expanded while the files are processed: a
+         * directory is walked depth first with its entries in byte
+         * order of their names, a list gets read line by line, so the
+         * order is the same from run to run and nothing needs the
+         * whole tree in memory. Symbolic links to directories are not
+         * followed.
+         *
+         * Files are dealt round robin to the deques of the worker
+         * threads; a worker whose deque runs dry steals from the back
+         * of the others, so a few huge files don't hold up the small
+         * ones queued behind them.
+         *
+         * At most Options_t::window files are between being found and
+         * being handed on. The walk stalls when the oldest of them is
+         * still busy, which keeps memory flat however big the corpus.
+         */
+
+        class CorpusScanner {
+        public:
+            struct Options_t {
+                Options_t();
+
+                unsigned workers;  //< threads calling the callback
+                size_t   window;   //< files in flight, done or not, before the walk stalls
+            };
+
+            /** Called with the index of a file in input order and its path
+             */
+
+            typedef std::function<void(size_t index,const std::string & path)> Callback_t;
+
+            explicit
+            CorpusScanner(const Options_t & o=Options_t()) : _o(o) {
+                if(_o.workers==0)
+                    _o.workers = 1;
+
+                if(_o.window<_o.workers)
+                    _o.window = _o.workers;
+            }
+
+            /** Add a file, or a directory to be walked recursively
+             */
+
+            void add(const std::string & path) {
+                _inputs.push_back(Input_t(path,false));
+            }
+
+            /** Add the paths listed in the file at path, one per line,
+                '-' reads them from stdin. Listed directories get
+                walked as well.
+             */
+
+            void add_list(const std::string & path) {
+                _inputs.push_back(Input_t(path,true));
+            }
+
+            const Options_t & get_options() const {
+                return _o;
+            }
+
+            /** Call f(index,path) for every file concurrently and
+                g(index,path) in input order once f is done with it and
+                with all files before. g gets called by the calling
+                thread. Returns the number of files; an exception thrown
+                by f or g stops the scan and is passed on.
+
+                Entries which can't be read, e.g. directories without
+                permission, are handed on like files, opening them is
+                left to f.
+             */
+
+            size_t scan(const Callback_t & f,const Callback_t & g);
+
+            /** Call r = f(path) for every file concurrently, and
+                g(path,r) in input order. Only the results of the
+                window of files in flight are kept.
+             */
+
+            template<class F,class G>
+            size_t run(F f,G g) {
+                typedef decltype(f(std::string())) Result_t;
+
+                std::vector<std::unique_ptr<Result_t>> r(_o.window);
+
+                return scan([&](size_t i,const std::string & path) {
+                    r[i%r.size()].reset(new Result_t(f(path)));
+                },[&](size_t i,const std::string & path) {
+                    std::unique_ptr<Result_t> v(std::move(r[i%r.size()]));
+                    g(path,std::move(*v));
+                });
+            }
+
+        private:
+            struct Input_t {
+                Input_t(const std::string & p,bool l) : path(p),list(l) {
+                }
+
+                std::string path;
+                bool        list;
+            };
+
+            Options_t            _o;
+            std::vector<Input_t> _inputs;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_CORPUS_SCANNER_H
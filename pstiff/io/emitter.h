@@ -0,0 +1,299 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_EMITTER_H
+#define PSTIFF_IO_EMITTER_H
+
+#include <pstiff/Types.h>
+
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The Emitter class
+         *
+         * Writes records of nested objects, arrays and scalars into a
+         * buffer of its own. The buffer grows to the biggest record
+         * seen and is reused from then on; numbers, hex and UTF-8 get
+         * formatted right into it, so emitting a field never
+         * allocates. Nothing gets written anywhere until write() or
+         * data() is called, typically once for many records.
+         *
+         * A record is a single object:
+         *
+         *   e.begin_record();
+         *   e.key("page").uint(0);
+         *   e.key("ids").begin_array().uint(10).uint(11).end_array();
+         *   e.end_record();
+         *
+         * The backends decide on the encoding, see NdjsonEmitter and
+         * BinaryEmitter.
+         */
+
+        class Emitter {
+        public:
+            typedef enum {
+                Ndjson,
+                Binary
+            } Format_t;
+
+            virtual
+            ~Emitter() {
+            }
+
+            /** A new emitter for f
+             */
+
+            static std::unique_ptr<Emitter> create(Format_t f);
+
+            virtual Emitter & begin_record() = 0;
+            virtual Emitter & end_record() = 0;
+
+            virtual Emitter & begin_object() = 0;
+            virtual Emitter & end_object() = 0;
+
+            virtual Emitter & begin_array() = 0;
+            virtual Emitter & end_array() = 0;
+
+            /** Name of the next value of an object
+             */
+
+            virtual Emitter & key(std::string_view k) = 0;
+
+            virtual Emitter & uint(uint64_t v) = 0;
+            virtual Emitter & sint(int64_t v) = 0;
+            virtual Emitter & boolean(bool v) = 0;
+
+            /** UTF-8 text; whatever isn't well formed UTF-8 gets
+                written as U+FFFD
+             */
+
+            virtual Emitter & string(std::string_view s) = 0;
+
+            /** 8 bit text of a Pascal string, MacRoman, written as
+                UTF-8
+             */
+
+            virtual Emitter & mac_string(std::string_view s) = 0;
+
+            /** UTF-16 text as Photoshop keeps it, written as UTF-8
+             */
+
+            virtual Emitter & string(std::wstring_view s) = 0;
+
+            /** Binary data
+             */
+
+            virtual Emitter & bytes(const Byte_t * p,size_t n) = 0;
+
+            /** The records emitted since the last clear()
+             */
+
+            const char * data() const {
+                return _buf.data();
+            }
+
+            size_t size() const {
+                return _n;
+            }
+
+            /** Drop the records, keeping the buffer
+             */
+
+            void clear() {
+                _n = 0;
+            }
+
+            /** Write the records to os and clear(); os doesn't get
+                flushed.
+             */
+
+            void write(std::ostream & os) {
+                os.write(data(),size());
+                clear();
+            }
+
+        protected:
+            Emitter() : _n(0) {
+            }
+
+            /** Room for n more bytes; the pointer is valid until the
+                next call
+             */
+
+            char * reserve(size_t n) {
+                if(_buf.size()-_n<n)
+                    _buf.resize(std::max(_buf.size()*2,_n+n));
+                return _buf.data()+_n;
+            }
+
+            /** The bytes up to e, inside of the last reserve(), are used
+             */
+
+            void commit(const char * e) {
+                _n = e-_buf.data();
+            }
+
+            void put(char c) {
+                *reserve(1) = c;
+                _n++;
+            }
+
+            void put(const char * p,size_t n) {
+                std::copy(p,p+n,reserve(n));
+                _n += n;
+            }
+
+            std::vector<char> _buf;
+            size_t            _n;
+        };
+
+        /**
+         * @brief The NdjsonEmitter class
+         *
+         * One JSON object per line. Binary data becomes a string of
+         * lower case hex digits.
+         */
+
+        class NdjsonEmitter : public Emitter {
+        public:
+            NdjsonEmitter() : _depth(0),_key(false) {
+            }
+
+            virtual Emitter & begin_record();
+            virtual Emitter & end_record();
+
+            virtual Emitter & begin_object();
+            virtual Emitter & end_object();
+
+            virtual Emitter & begin_array();
+            virtual Emitter & end_array();
+
+            virtual Emitter & key(std::string_view k);
+
+            virtual Emitter & uint(uint64_t v);
+            virtual Emitter & sint(int64_t v);
+            virtual Emitter & boolean(bool v);
+            virtual Emitter & string(std::string_view s);
+            virtual Emitter & mac_string(std::string_view s);
+            virtual Emitter & string(std::wstring_view s);
+            virtual Emitter & bytes(const Byte_t * p,size_t n);
+
+        private:
+            static const size_t MaxDepth = 32;
+
+            /** The comma in front of all but the first value
+             */
+
+            void separate();
+
+            void open(char c);
+            void close(char c);
+
+            /** s as JSON string; f maps the characters of s
+                starting at i onto code points
+             */
+
+            template<class S,class F>
+            void quote(S s,F f);
+
+            void quote(std::string_view s);
+
+            size_t _depth;
+            bool   _first[MaxDepth];
+            bool   _key;      //< a key is waiting for its value
+        };
+
+        /**
+         * @brief The BinaryEmitter class
+         *
+         * A record is its size as big endian uint32_t followed by
+         * that many bytes of items. An item is a tag byte and, for
+         * some tags, a payload:
+         *
+         *   ObjectBegin  ObjectEnd  ArrayBegin  ArrayEnd
+         *   Key          varint length, UTF-8
+         *   UInt         varint
+         *   SInt         zigzag varint
+         *   False  True
+         *   String       varint length, UTF-8
+         *   Bytes        varint length, data
+         *
+         * A varint is an LEB128 number, 7 bits per byte starting with
+         * the low ones, the high bit set on all but the last. The
+         * record itself is the outermost object, without tags.
+         */
+
+        class BinaryEmitter : public Emitter {
+        public:
+            typedef enum {
+                ObjectBegin = 1,
+                ObjectEnd,
+                ArrayBegin,
+                ArrayEnd,
+                Key,
+                UInt,
+                SInt,
+                False,
+                True,
+                String,
+                Bytes
+            } Tag_t;
+
+            BinaryEmitter() : _record(0) {
+            }
+
+            virtual Emitter & begin_record();
+            virtual Emitter & end_record();
+
+            virtual Emitter & begin_object();
+            virtual Emitter & end_object();
+
+            virtual Emitter & begin_array();
+            virtual Emitter & end_array();
+
+            virtual Emitter & key(std::string_view k);
+
+            virtual Emitter & uint(uint64_t v);
+            virtual Emitter & sint(int64_t v);
+            virtual Emitter & boolean(bool v);
+            virtual Emitter & string(std::string_view s);
+            virtual Emitter & mac_string(std::string_view s);
+            virtual Emitter & string(std::wstring_view s);
+            virtual Emitter & bytes(const Byte_t * p,size_t n);
+
+        private:
+            void varint(uint64_t v);
+
+            void tagged(Tag_t t,const char * p,size_t n);
+
+            size_t _record;   //< where the size of the current record goes
+        };
+    }
+}
+
+#endif // PSTIFF_IO_EMITTER_H
@@ -0,0 +1,245 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_INDEX_CACHE_H
+#define PSTIFF_IO_INDEX_CACHE_H
+
+#include <pstiff/Types.h>
+#include <pstiff/io/mapped_file.h>
+
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The IndexCache class
+         *
+         * Persistent index of what files have been found to contain,
+         * so a file which hasn't changed since doesn't need to be read
+         * again. A file is identified by device and inode and counts
+         * as unchanged while size and modification time stay the same,
+         * which a stat() tells.
+         *
+         * For every page with Photoshop resources the index keeps the
+         * position of the blob in the file and a summary: the blocks
+         * of the typed resources (spot colors, alpha names and ids,
+         * display and version info, ...) as they are in the blob, so
+         * the usual ResourceDecoder decodes them right from the
+         * mapping. A blob with malformed blocks is kept as a whole,
+         * which reproduces the errors found in it.
+         *
+         * The index file gets mapped, lookups are a binary search on
+         * the mapping and thread safe. New entries are written to a
+         * temporary file while they come in; commit() adds the old
+         * entries which haven't been replaced and moves it into place.
+         * A scan covering all files an index is for can have it pruned:
+         * files found unchanged get keep()t and commit(true) drops the
+         * entries of all others, files deleted or replaced meanwhile.
+         * The layout is the one of the host, an index written by a
+         * machine with another byte order counts as empty. Records
+         * carry a checksum, damaged ones count as missing.
+         */
+
+        class IndexCache {
+        public:
+            /** What a file turned out to be; Other for files which are
+                no image we know
+             */
+
+            typedef enum {
+                Other,
+                Tiff,
+                Psd,
+                Jpeg
+            } Type_t;
+
+            struct Key_t {
+                Key_t() : dev(0),ino(0),size(0),mtime(0) {
+                }
+
+                uint64_t dev;
+                uint64_t ino;
+                uint64_t size;
+                int64_t  mtime;  //< nanoseconds since the epoch
+            };
+
+            /** The Photoshop resources of page page, offset and size
+                locate the blob in the file; size is 0 where it's not
+                in one piece like in a JPEG with several APP13 segments.
+             */
+
+            struct Page_t {
+                Page_t() : page(0),offset(0),size(0) {
+                }
+
+                uint32_t page;
+                uint64_t offset;
+                uint64_t size;
+                Span_t   summary;
+            };
+
+            struct Record_t {
+                Record_t() : type(Other) {
+                }
+
+                Type_t              type;
+                std::vector<Page_t> pages;
+            };
+
+            IndexCache() : _h(NULL),_fd(-1),_written(0) {
+            }
+
+            explicit
+            IndexCache(const std::string & path) : IndexCache() {
+                open(path);
+            }
+
+            IndexCache(const IndexCache &) = delete;
+            IndexCache & operator=(const IndexCache &) = delete;
+
+            ~IndexCache() {
+                close();
+            }
+
+            /** Map the index at path. Returns false if there's none or
+                it's not usable, the cache starts out empty then and
+                commit() creates a new one.
+             */
+
+            bool open(const std::string & path);
+
+            /** Drop the mapping and all entries not committed
+             */
+
+            void close();
+
+            /** Entries in the mapped index
+             */
+
+            size_t size() const;
+
+            /** Key of the file at path; false if it can't be stat()ed
+             */
+
+            static bool get_key(const std::string & path,Key_t & k);
+
+            /** Look up k. The summaries of r point into the mapping and
+                stay valid until the next open(), commit() or close().
+             */
+
+            bool find(const Key_t & k,Record_t & r) const;
+
+            /** Add or replace the entry for k; the summaries get copied.
+                Only the first one for a file counts until the next
+                commit(), like when links lead to it more than once.
+                Not thread safe.
+             */
+
+            void add(const Key_t & k,const Record_t & r);
+
+            /** Carry the entry for k over to commit(true) as it is,
+                for a file found unchanged. Not thread safe.
+             */
+
+            void keep(const Key_t & k);
+
+            /** Number of entries add()ed since the last commit()
+             */
+
+            size_t get_added() const {
+                return _added.size();
+            }
+
+            /** Write the index with all entries added and remap it.
+                With prune the old entries not keep()t since the last
+                commit() get dropped. Nothing gets written if there's
+                nothing to add or drop. Throws if the index can't be
+                written.
+             */
+
+            void commit(bool prune=false);
+
+            /** Append the summary of the blob p[n] to out, see above
+             */
+
+            static void summarize(const Byte_t * p,size_t n,std::vector<Byte_t> & out);
+
+        private:
+            struct Entry_t {
+                uint64_t dev;
+                uint64_t ino;
+                uint64_t size;
+                int64_t  mtime;
+                uint64_t offset;  //< of the record in the index file
+                uint32_t length;  //< of the record
+                uint32_t type;
+                uint32_t check;   //< FNV-1a of the record
+                uint32_t reserved;
+            };
+
+            struct Header_t {
+                char     magic[8];
+                uint32_t order;       //< ByteOrder as written by the host
+                uint32_t entry_size;
+                uint64_t count;
+                uint64_t table;       //< offset of the entries, sorted by device and inode
+            };
+
+            static const uint32_t ByteOrder = 0x01020304;
+
+            static bool less(const Entry_t & a,const Entry_t & b) {
+                return a.dev<b.dev || (a.dev==b.dev && a.ino<b.ino);
+            }
+
+            const Entry_t * get_table() const;
+
+            /** The record of e if it's intact, NULL otherwise
+             */
+
+            const Byte_t * get_record(const Entry_t & e) const;
+
+            /** Start the temporary file
+             */
+
+            void create();
+
+            void write(const void * p,size_t n);
+            void flush();
+
+            std::string          _path;
+            MappedFile           _file;
+            const Header_t     * _h;
+            std::string          _tmp;
+            int                  _fd;
+            uint64_t             _written;  //< bytes of the temporary file, including the buffer
+            std::vector<Byte_t>  _buf;
+            std::vector<Entry_t> _added;
+            std::set<std::pair<uint64_t,uint64_t>> _keys;  //< device and inode of _added
+            std::set<std::tuple<uint64_t,uint64_t,uint64_t,int64_t>> _kept;  //< keys passed to keep()
+        };
+    }
+}
+
+#endif // PSTIFF_IO_INDEX_CACHE_H
@@ -0,0 +1,128 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_MAPPED_FILE_H
+#define PSTIFF_IO_MAPPED_FILE_H
+
+#include <pstiff/Types.h>
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The MappedFile class
+         *
+         * Read only mapping of a whole file. The mapping is held by a
+         * Buffer_t; alias() hands out buffers pointing into it which
+         * keep it alive, so Resources can be decoded from it without
+         * copying and may outlive the MappedFile.
+         */
+
+        class MappedFile {
+        public:
+            MappedFile() : _n(0) {
+            }
+
+            explicit
+            MappedFile(const std::string & path) : _n(0) {
+                open(path);
+            }
+
+            /** Map the file at path. Only the pages touched later on
+                get read. Returns false if the file can't be opened
+                or mapped.
+             */
+
+            bool open(const std::string & path) {
+                close();
+
+                int fd = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+
+                if(fd<0)
+                    return false;
+
+                struct stat st;
+
+                if(::fstat(fd,&st)!=0 || !S_ISREG(st.st_mode) || st.st_size==0) {
+                    ::close(fd);
+                    return false;
+                }
+
+                size_t n = (size_t)st.st_size;
+                void * p = ::mmap(NULL,n,PROT_READ,MAP_PRIVATE,fd,0);
+
+                ::close(fd);
+
+                if(p==MAP_FAILED)
+                    return false;
+
+                // Directories and tags are scattered all over the file
+                ::madvise(p,n,MADV_RANDOM);
+
+                _b = Buffer_t((const Byte_t *)p,[n](const Byte_t * q) { ::munmap((void *)q,n); });
+                _n = n;
+
+                return true;
+            }
+
+            void close() {
+                _b.reset();
+                _n = 0;
+            }
+
+            bool is_open() const {
+                return _b!=NULL;
+            }
+
+            const Byte_t * data() const {
+                return _b.get();
+            }
+
+            size_t size() const {
+                return _n;
+            }
+
+            Span_t get_span() const {
+                return Span_t(data(),size());
+            }
+
+            /** Buffer starting at p (within the mapping) sharing the
+                ownership of the mapping
+             */
+
+            Buffer_t alias(const Byte_t * p) const {
+                return Buffer_t(_b,p);
+            }
+
+        private:
+            Buffer_t _b;
+            size_t   _n;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_MAPPED_FILE_H
@@ -0,0 +1,111 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_MEMORY_TIFF_H
+#define PSTIFF_IO_MEMORY_TIFF_H
+
+#include "tiffio.h"
+#include <pstiff/Types.h>
+
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The MemoryTiff class
+         *
+         * A TIFF handle on bytes kept in memory instead of a file,
+         * built on TIFFClientOpen. Either read only on a caller owned
+         * blob, which libtiff gets to see as a mapped file, or read/write
+         * on a caller owned vector which grows as libtiff writes
+         * behind its end.
+         *
+         * The handle refers to this object, so it can neither be
+         * copied nor moved. The buffer has to outlive it.
+         */
+
+        class MemoryTiff {
+        public:
+            /** Open the TIFF p[n] read only
+             */
+
+            MemoryTiff(const Byte_t * p,size_t n);
+
+            /** Open the TIFF in v with mode "r", "r+" (e.g. to
+                rewrite a directory) or "w" (v gets truncated).
+             */
+
+            MemoryTiff(std::vector<Byte_t> & v,const char * mode="r+");
+
+            MemoryTiff(const MemoryTiff &) = delete;
+            MemoryTiff & operator=(const MemoryTiff &) = delete;
+
+            ~MemoryTiff() {
+                close();
+            }
+
+            TIFF * get() const {
+                return _tif;
+            }
+
+            bool is_open() const {
+                return _tif!=NULL;
+            }
+
+            /** Close the handle, flushing whatever libtiff still
+                holds into the vector.
+             */
+
+            void close() {
+                if(_tif!=NULL)
+                    TIFFClose(_tif);
+                _tif = NULL;
+            }
+
+        private:
+            void open(const char * mode);
+
+            size_t get_size() const {
+                return _rw!=NULL ? _rw->size() : _n;
+            }
+
+            const Byte_t * get_data() const {
+                return _rw!=NULL ? _rw->data() : _ro;
+            }
+
+            static tmsize_t Read(thandle_t h,void * p,tmsize_t n);
+            static tmsize_t Write(thandle_t h,void * p,tmsize_t n);
+            static toff_t   Seek(thandle_t h,toff_t o,int w);
+            static int      Close(thandle_t h);
+            static toff_t   Size(thandle_t h);
+            static int      Map(thandle_t h,void ** p,toff_t * n);
+            static void     Unmap(thandle_t h,void * p,toff_t n);
+
+            const Byte_t        * _ro;
+            size_t                _n;
+            std::vector<Byte_t> * _rw;
+            uint64_t              _pos;
+            TIFF                * _tif;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_MEMORY_TIFF_H
@@ -0,0 +1,183 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_PAGE_PROCESSOR_H
+#define PSTIFF_IO_PAGE_PROCESSOR_H
+
+#include "tiffio.h"
+#include <pstiff/Types.h>
+#include <pstiff/ParseStatus.h>
+#include <pstiff/io/mapped_file.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The PageProcessor class
+         *
+         * Runs a callback on every page of a multi page TIFF, many
+         * pages at once. The directory chain gets walked once up front
+         * (see TiffWalker), which leaves the offset of every page.
+         * Each worker thread then has a libtiff handle of its own on
+         * the same mapped bytes and moves it from page to page with
+         * TIFFSetSubDirectory(), so no worker ever reads the
+         * directories in between.
+         *
+         * The callbacks run concurrently and in no particular order.
+         * The two callback version of run() hands their results on in
+         * page order.
+         */
+
+        class PageProcessor {
+        public:
+            struct Options_t {
+                Options_t();
+
+                unsigned workers;  //< threads, 1 runs all pages in the calling thread
+            };
+
+            /** Called with a handle positioned at page
+             */
+
+            typedef std::function<void(size_t page,TIFF * tif)> Callback_t;
+
+            PageProcessor(const Options_t & o=Options_t()) : _o(o),_p(NULL),_n(0) {
+            }
+
+            explicit
+            PageProcessor(const std::string & path,const Options_t & o=Options_t()) : PageProcessor(o) {
+                open(path);
+            }
+
+            PageProcessor(const PageProcessor &) = delete;
+            PageProcessor & operator=(const PageProcessor &) = delete;
+
+            /** Map path and find its pages. Returns false if it can't
+                be mapped; format errors are left to get_status().
+             */
+
+            bool open(const std::string & path);
+
+            /** Find the pages of the TIFF p[n], which has to outlive
+                the processor.
+             */
+
+            bool open(const Byte_t * p,size_t n);
+
+            void close();
+
+            bool is_open() const {
+                return _p!=NULL;
+            }
+
+            /** Outcome of the walk along the directory chain. The pages
+                found before an error get processed nevertheless.
+             */
+
+            const ParseStatus & get_status() const {
+                return _st;
+            }
+
+            size_t get_pages() const {
+                return _offsets.size();
+            }
+
+            /** File offsets of the directories, one per page
+             */
+
+            const std::vector<uint64_t> & get_offsets() const {
+                return _offsets;
+            }
+
+            const Options_t & get_options() const {
+                return _o;
+            }
+
+            /** Call f(page,tif) for every page. Returns the first
+                failure, e.g. a page libtiff refuses to read; f never
+                sees such a page.
+             */
+
+            ParseStatus run(const Callback_t & f);
+
+            /** Call r = f(page,tif) for every page concurrently, and
+                g(page,r) in page order as soon as all pages before have
+                been handed on. g gets called by one thread at a time.
+                Results wait in memory until their turn has come.
+             */
+
+            template<class F,class G>
+            ParseStatus run(F f,G g) {
+                typedef decltype(f(size_t(),(TIFF *)NULL)) Result_t;
+
+                std::mutex                             m;
+                std::vector<std::unique_ptr<Result_t>> r(get_pages());
+                std::vector<bool>                      done(get_pages(),false);
+                size_t                                 next = 0;
+
+                // Pages libtiff refuses come back without a result
+
+                auto finish = [&](size_t page,std::unique_ptr<Result_t> v) {
+                    std::lock_guard<std::mutex> l(m);
+
+                    r[page]    = std::move(v);
+                    done[page] = true;
+
+                    for(;next<r.size() && done[next];next++) {
+                        if(r[next])
+                            g(next,std::move(*r[next]));
+                        r[next].reset();
+                    }
+                };
+
+                return process([&](size_t page,TIFF * tif) {
+                    if(tif==NULL)
+                        finish(page,NULL);
+                    else
+                        finish(page,std::unique_ptr<Result_t>(new Result_t(f(page,tif))));
+                },true);
+            }
+
+        private:
+            /** With failed set f gets called with a NULL handle for the
+                pages which can't be read
+             */
+
+            ParseStatus process(const Callback_t & f,bool failed);
+
+            ParseStatus scan();
+
+            Options_t             _o;
+            MappedFile            _file;
+            const Byte_t        * _p;
+            size_t                _n;
+            ParseStatus           _st;
+            std::vector<uint64_t> _offsets;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_PAGE_PROCESSOR_H
@@ -0,0 +1,215 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_PAYLOAD_STORE_H
+#define PSTIFF_IO_PAYLOAD_STORE_H
+
+#include <pstiff/Types.h>
+#include <pstiff/io/mapped_file.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The PayloadStore class
+         *
+         * Content addressed store for the data of resources which
+         * come up in many files, ICC profiles, print settings or the
+         * blocks of plugins. Each distinct payload is kept once and
+         * known by its hash; what a file contains is a list of Ref_t
+         * naming the hashes, so which files use a payload is a lookup.
+         *
+         * Everything goes into a single pack file which only ever
+         * gets appended to: payloads and the records of the files,
+         * the last record of a path replacing the ones before. open()
+         * reads the frames and builds the tables in memory, checking
+         * each payload against its hash. A frame cut short or left
+         * with bad data by a crash is dropped along with everything
+         * behind it. Payloads are handed out as spans into mappings
+         * of the pack, which stay valid until close().
+         *
+         * Hashes are XXH64 of the data. Two payloads with the same
+         * hash but different data get consecutive hashes, so a hash
+         * always stands for the data it has been handed out for.
+         *
+         * All members are thread safe. The layout is the one of the
+         * host.
+         */
+
+        class PayloadStore {
+        public:
+            typedef uint64_t Hash_t;
+
+            /** Resource id of page page has its data stored as hash
+             */
+
+            struct Ref_t {
+                Ref_t() : page(0),id(0),hash(0) {
+                }
+
+                uint32_t page;
+                uint32_t id;
+                Hash_t   hash;
+            };
+
+            typedef std::vector<Ref_t> Refs_t;
+
+            PayloadStore() : _fd(-1),_end(0),_mapped(0),_saved(0) {
+            }
+
+            explicit
+            PayloadStore(const std::string & path,bool write=true) : PayloadStore() {
+                open(path,write);
+            }
+
+            PayloadStore(const PayloadStore &) = delete;
+            PayloadStore & operator=(const PayloadStore &) = delete;
+
+            ~PayloadStore() {
+                close();
+            }
+
+            /** Open the pack at path, creating it if write is set.
+                Returns false if it can't be opened or is no pack.
+             */
+
+            bool open(const std::string & path,bool write=true);
+
+            void close();
+
+            /** Number of distinct payloads and of files
+             */
+
+            size_t size() const;
+            size_t get_files() const;
+
+            /** Bytes of payload put() didn't need to store since open()
+             */
+
+            uint64_t get_saved() const;
+
+            /** Store p[n] unless it's there already; returns its hash.
+                Throws if the pack can't be written.
+             */
+
+            Hash_t put(const Byte_t * p,size_t n);
+
+            /** The payload known as h
+             */
+
+            bool get(Hash_t h,Span_t & s) const;
+
+            /** Store the data of the blocks of the blob p[n] of page
+                page which have at least min bytes and add a Ref_t
+                for each of them to refs. Malformed blocks get skipped.
+             */
+
+            void put_resources(uint32_t page,const Byte_t * p,size_t n,size_t min,Refs_t & refs);
+
+            /** Record that path refers to refs, replacing what has
+                been recorded for it before
+             */
+
+            void add_file(const std::string & path,const Refs_t & refs);
+
+            /** What has been recorded for path
+             */
+
+            bool get_refs(const std::string & path,Refs_t & refs) const;
+
+            /** The files referring to h, sorted
+             */
+
+            std::vector<std::string> get_users(Hash_t h) const;
+
+        private:
+            typedef enum {
+                Payload = 1,
+                File
+            } Kind_t;
+
+            struct Frame_t {
+                uint32_t kind;
+                uint32_t reserved;
+                uint64_t size;    //< of the data following the frame, not counting the padding to 8
+                uint64_t hash;    //< of the payload
+            };
+
+            struct Header_t {
+                char     magic[8];
+                uint32_t order;
+                uint32_t frame_size;
+            };
+
+            struct Slot_t {
+                uint64_t offset;  //< of the data in the pack
+                uint64_t size;
+            };
+
+            static const uint32_t ByteOrder = 0x01020304;
+
+            /** Append a frame for p[n]; returns the offset of the data
+             */
+
+            uint64_t append(Kind_t k,Hash_t h,const Byte_t * p,size_t n);
+
+            /** The bytes at offset in the pack, mapping it again if
+                they're behind the last mapping
+             */
+
+            const Byte_t * at(uint64_t offset,uint64_t size) const;
+
+            /** The bytes at offset in the pack, from the last mapping
+                or read into b if they're behind it. For the writer
+                which mostly looks at what it just appended, without
+                mapping the pack anew each time.
+             */
+
+            const Byte_t * read(uint64_t offset,uint64_t size,std::vector<Byte_t> & b) const;
+
+            /** Take the record of path at s into the tables
+             */
+
+            void index_file(const std::string & path,const Refs_t & refs,const Slot_t & s);
+
+            bool parse_file(const Byte_t * p,size_t n,std::string & path,Refs_t & refs) const;
+
+            mutable std::mutex                                  _m;
+            std::string                                         _path;
+            int                                                 _fd;
+            uint64_t                                            _end;
+            mutable std::vector<std::unique_ptr<MappedFile>>    _maps;
+            mutable uint64_t                                    _mapped;
+            uint64_t                                            _saved;
+            std::unordered_map<Hash_t,Slot_t>                   _payloads;
+            std::unordered_map<std::string,Slot_t>              _files;
+            std::unordered_map<Hash_t,std::set<std::string>>    _users;
+        };
+    }
+}
+
+#endif // PSTIFF_IO_PAYLOAD_STORE_H
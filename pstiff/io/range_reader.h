@@ -0,0 +1,185 @@
+//========================================================================
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_IO_RANGE_READER_H
+#define PSTIFF_IO_RANGE_READER_H
+
+#include "tiffio.h"
+#include <pstiff/Types.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace PsTiff {
+    namespace IO  {
+
+        /**
+         * @brief The RangeReader class
+         *
+         * Read only access to a file by pread() of whole blocks kept in
+         * a small LRU cache. Meant for network file systems where every
+         * request costs a round trip: misses of neighbouring blocks get
+         * coalesced into a single request, gaps up to a few blocks are
+         * read along rather than split, and prefetch() lets a caller
+         * fetch what it is going to need in one go.
+         *
+         * A RangeReader is not thread safe; use one per thread.
+         */
+
+        class RangeReader {
+        public:
+            struct Options_t {
+                Options_t() : block_size(16*1024),cache_blocks(64),max_gap(2),readahead(1),prefetch(true),latency(0) {
+                }
+
+                size_t                    block_size;   //< unit of caching and reading
+                size_t                    cache_blocks; //< capacity of the cache in blocks
+                size_t                    max_gap;      //< cached blocks read again to merge two requests
+                size_t                    readahead;    //< blocks read behind a miss
+                bool                      prefetch;     //< let open_tiff() prefetch the directories
+                std::chrono::microseconds latency;      //< artificial delay added to every request
+            };
+
+            struct Stats_t {
+                Stats_t() : requests(0),bytes(0),hits(0),misses(0) {
+                }
+
+                uint64_t requests;  //< pread() calls
+                uint64_t bytes;     //< bytes read from the file
+                uint64_t hits;      //< blocks found in the cache
+                uint64_t misses;    //< blocks which had to be read
+            };
+
+            RangeReader() : _fd(-1),_size(0),_pos(0),_tick(0) {
+            }
+
+            explicit
+            RangeReader(const std::string & path,const Options_t & o=Options_t()) : _fd(-1),_size(0),_pos(0),_tick(0) {
+                open(path,o);
+            }
+
+            RangeReader(const RangeReader &) = delete;
+            RangeReader & operator=(const RangeReader &) = delete;
+
+            ~RangeReader() {
+                close();
+            }
+
+            bool open(const std::string & path,const Options_t & o=Options_t());
+
+            void close();
+
+            bool is_open() const {
+                return _fd>=0;
+            }
+
+            uint64_t get_size() const {
+                return _size;
+            }
+
+            const Options_t & get_options() const {
+                return _o;
+            }
+
+            const Stats_t & get_stats() const {
+                return _stats;
+            }
+
+            void reset_stats() {
+                _stats = Stats_t();
+            }
+
+            /** Copy up to n bytes at off into p. Returns the number of
+                bytes copied, less than n only at the end of the file.
+             */
+
+            size_t read(uint64_t off,void * p,size_t n);
+
+            /** Make sure [off;off+n) is cached, reading all missing
+                blocks with as few requests as possible.
+             */
+
+            void prefetch(uint64_t off,size_t n);
+
+            /** Speculatively fetch the directory chain of a TIFF or
+                BigTIFF and the payloads of the Photoshop, XMP and 37724
+                tags.
+             */
+
+            void prefetch_directories();
+
+            /** A libtiff handle reading through this reader. It has to
+                be closed before the reader goes away.
+             */
+
+            TIFF * open_tiff(const char * name="range");
+
+        private:
+            struct Block_t {
+                Block_t() : index(UINT64_MAX),tick(0) {
+                }
+
+                uint64_t            index;
+                uint64_t            tick;
+                std::vector<Byte_t> data;
+            };
+
+            /** Largest number of blocks fetched for a single request;
+                anything bigger bypasses the cache.
+             */
+
+            size_t get_limit() const {
+                return _o.cache_blocks/2 > 0 ? _o.cache_blocks/2 : 1;
+            }
+
+            uint64_t get_block_count() const {
+                return (_size + _o.block_size - 1) / _o.block_size;
+            }
+
+            Block_t * find(uint64_t b);
+            Block_t * slot();
+            void      want(uint64_t off,uint64_t n);
+            void      fetch();
+            void      load(uint64_t b0,uint64_t b1);
+            size_t    pread(uint64_t off,void * p,size_t n);
+
+            static tmsize_t Read(thandle_t h,void * p,tmsize_t n);
+            static tmsize_t Write(thandle_t h,void * p,tmsize_t n);
+            static toff_t   Seek(thandle_t h,toff_t o,int w);
+            static int      Close(thandle_t h);
+            static toff_t   Size(thandle_t h);
+            static int      Map(thandle_t h,void ** p,toff_t * n);
+            static void     Unmap(thandle_t h,void * p,toff_t n);
+
+            int                  _fd;
+            uint64_t             _size;
+            uint64_t             _pos;   //< position of the libtiff handle
+            uint64_t             _tick;
+            Options_t            _o;
+            Stats_t              _stats;
+            std::vector<Block_t>  _cache;
+            std::vector<uint64_t> _want;  //< blocks the next fetch() is about
+            std::vector<Byte_t>   _buf;   //< landing zone of coalesced reads
+        };
+    }
+}
+
+#endif // PSTIFF_IO_RANGE_READER_H
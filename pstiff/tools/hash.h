@@ -0,0 +1,121 @@
+//========================================================================
+//
+// pstiff/tools/hash.h
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TOOLS_HASH_H
+#define PSTIFF_TOOLS_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PsTiff {
+
+    namespace Tools {
+
+        namespace Hash {
+            const uint64_t P1 = 11400714785074694791ULL;
+            const uint64_t P2 = 14029467366897019727ULL;
+            const uint64_t P3 =  1609587929392839161ULL;
+            const uint64_t P4 =  9650029242287828579ULL;
+            const uint64_t P5 =  2870177450012600261ULL;
+
+            inline uint64_t rotl(uint64_t v,int r) {
+                return (v<<r) | (v>>(64-r));
+            }
+
+            inline uint64_t get64(const uint8_t * p) {
+                return (uint64_t)p[0]     | (uint64_t)p[1]<<8  | (uint64_t)p[2]<<16 | (uint64_t)p[3]<<24 |
+                       (uint64_t)p[4]<<32 | (uint64_t)p[5]<<40 | (uint64_t)p[6]<<48 | (uint64_t)p[7]<<56;
+            }
+
+            inline uint64_t get32(const uint8_t * p) {
+                return (uint64_t)p[0] | (uint64_t)p[1]<<8 | (uint64_t)p[2]<<16 | (uint64_t)p[3]<<24;
+            }
+
+            inline uint64_t round(uint64_t acc,uint64_t v) {
+                return rotl(acc+v*P2,31)*P1;
+            }
+
+            inline uint64_t merge(uint64_t h,uint64_t v) {
+                return (h ^ round(0,v))*P1+P4;
+            }
+        }
+
+        /** XXH64 of p[n]: fast, well spread and the same on every
+            host, but no protection against anyone making collisions
+            on purpose.
+         */
+
+        inline
+        uint64_t hash64(const void * data,size_t n,uint64_t seed=0) {
+            using namespace Hash;
+
+            const uint8_t * p = (const uint8_t *)data;
+            const uint8_t * e = p+n;
+            uint64_t        h;
+
+            if(n>=32) {
+                uint64_t v1 = seed+P1+P2;
+                uint64_t v2 = seed+P2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed-P1;
+
+                for(;e-p>=32;p+=32) {
+                    v1 = round(v1,get64(p));
+                    v2 = round(v2,get64(p+8));
+                    v3 = round(v3,get64(p+16));
+                    v4 = round(v4,get64(p+24));
+                }
+
+                h = rotl(v1,1)+rotl(v2,7)+rotl(v3,12)+rotl(v4,18);
+                h = merge(h,v1);
+                h = merge(h,v2);
+                h = merge(h,v3);
+                h = merge(h,v4);
+            } else {
+                h = seed+P5;
+            }
+
+            h += n;
+
+            for(;e-p>=8;p+=8)
+                h = rotl(h ^ round(0,get64(p)),27)*P1+P4;
+
+            if(e-p>=4) {
+                h = rotl(h ^ get32(p)*P1,23)*P2+P3;
+                p += 4;
+            }
+
+            for(;p<e;p++)
+                h = rotl(h ^ *p*P5,11)*P1;
+
+            h ^= h>>33;
+            h *= P2;
+            h ^= h>>29;
+            h *= P3;
+            h ^= h>>32;
+
+            return h;
+        }
+    }
+}
+
+#endif // PSTIFF_TOOLS_HASH_H
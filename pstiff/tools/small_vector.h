@@ -0,0 +1,343 @@
+//========================================================================
+//
+// pstiff/tools/small_vector.h
+//
+// Copyright 2014 Sebastian Kloska (oncaphillis@snafu.de)
+//
+// PSTIFF is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// AGG is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with PSTIFF; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//
+//========================================================================
+
+#ifndef PSTIFF_TOOLS_SMALL_VECTOR_H
+#define PSTIFF_TOOLS_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <stddef.h>
+
+namespace PsTiff {
+
+    namespace Tools {
+
+        /**
+         * @brief The SmallVector class
+         *
+         * A vector keeping up to N elements inside the object itself.
+         * Only if it grows beyond that the elements move to the heap.
+         * Most channel tables hold a handful of entries, so for them
+         * no allocation happens at all.
+         *
+         * Heap storage comes from a std::pmr::memory_resource. Like the
+         * std::pmr containers copies use the default resource while
+         * moves keep the one of their source, and elements taking an
+         * allocator, e.g. std::pmr::string, get constructed with the
+         * resource of the vector they're in.
+         */
+
+        template<class T,size_t N>
+        class SmallVector {
+            static_assert(N>0,"SmallVector needs an inline capacity");
+        public:
+            typedef T         value_type;
+            typedef T       * iterator;
+            typedef const T * const_iterator;
+            typedef size_t    size_type;
+
+            explicit
+            SmallVector(std::pmr::memory_resource * mr=std::pmr::get_default_resource())
+                : _p(local()),_n(0),_cap(N),_mr(mr) {
+            }
+
+            SmallVector(const SmallVector & o)
+                : _p(local()),_n(0),_cap(N),_mr(std::pmr::get_default_resource()) {
+                assign(o.begin(),o.end());
+            }
+
+            SmallVector(SmallVector && o) noexcept : _p(local()),_n(0),_cap(N),_mr(o._mr) {
+                steal(o);
+            }
+
+            ~SmallVector() {
+                clear();
+                release();
+            }
+
+            SmallVector & operator=(const SmallVector & o) {
+                if(this!=&o)
+                    assign(o.begin(),o.end());
+                return *this;
+            }
+
+            /** Moving between different resources has to move the
+                elements one by one, into this resource.
+             */
+
+            SmallVector & operator=(SmallVector && o) {
+                if(this==&o)
+                    return *this;
+
+                if(_mr==o._mr) {
+                    clear();
+                    release();
+                    _p   = local();
+                    _cap = N;
+                    steal(o);
+                } else {
+                    clear();
+                    reserve(o._n);
+                    for(size_t i=0;i<o._n;i++,_n++)
+                        construct(_p+i,std::move(o._p[i]));
+                    o.clear();
+                }
+                return *this;
+            }
+
+            std::pmr::memory_resource * get_memory_resource() const {
+                return _mr;
+            }
+
+            size_t size() const {
+                return _n;
+            }
+
+            bool empty() const {
+                return _n==0;
+            }
+
+            size_t capacity() const {
+                return _cap;
+            }
+
+            T * data() {
+                return _p;
+            }
+
+            const T * data() const {
+                return _p;
+            }
+
+            iterator begin() {
+                return _p;
+            }
+
+            iterator end() {
+                return _p+_n;
+            }
+
+            const_iterator begin() const {
+                return _p;
+            }
+
+            const_iterator end() const {
+                return _p+_n;
+            }
+
+            T & operator[](size_t i) {
+                return _p[i];
+            }
+
+            const T & operator[](size_t i) const {
+                return _p[i];
+            }
+
+            T & at(size_t i) {
+                if(i>=_n)
+                    throw std::out_of_range("SmallVector index out of range");
+                return _p[i];
+            }
+
+            const T & at(size_t i) const {
+                if(i>=_n)
+                    throw std::out_of_range("SmallVector index out of range");
+                return _p[i];
+            }
+
+            T & back() {
+                return _p[_n-1];
+            }
+
+            const T & back() const {
+                return _p[_n-1];
+            }
+
+            void reserve(size_t n) {
+                if(n>_cap)
+                    grow(n,[](T *) { return 0; });
+            }
+
+            /** New elements get value initialized
+             */
+
+            void resize(size_t n) {
+                if(n<_n) {
+                    std::destroy(_p+n,_p+_n);
+                    _n = n;
+                    return;
+                }
+                reserve(n);
+                for(;_n<n;_n++)
+                    construct(_p+_n);
+            }
+
+            void push_back(const T & t) {
+                emplace_back(t);
+            }
+
+            void push_back(T && t) {
+                emplace_back(std::move(t));
+            }
+
+            /** a may refer to an element of this vector
+             */
+
+            template<class ... A>
+            T & emplace_back(A && ... a) {
+                if(_n==_cap) {
+                    grow(_cap*2,[&](T * p) {
+                        construct(p,std::forward<A>(a)...);
+                        return 1;
+                    });
+                } else {
+                    construct(_p+_n,std::forward<A>(a)...);
+                    _n++;
+                }
+                return back();
+            }
+
+            void pop_back() {
+                _p[--_n].~T();
+            }
+
+            void clear() {
+                std::destroy(_p,_p+_n);
+                _n = 0;
+            }
+
+            /** Append [b;e), which may be part of this vector. I has
+                to be a forward iterator.
+             */
+
+            template<class I>
+            void append(I b,I e) {
+                size_t m = std::distance(b,e);
+
+                if(_n+m<=_cap) {
+                    for(;b!=e;++b,++_n)
+                        construct(_p+_n,*b);
+                    return;
+                }
+
+                grow(std::max(_n+m,_cap*2),[&](T * p) {
+                    size_t k = 0;
+
+                    try {
+                        for(;b!=e;++b,++k)
+                            construct(p+k,*b);
+                    } catch(...) {
+                        std::destroy(p,p+k);
+                        throw;
+                    }
+
+                    return k;
+                });
+            }
+
+            template<class I>
+            void assign(I b,I e) {
+                clear();
+                append(b,e);
+            }
+
+        private:
+            /** Move to a new block of n elements. f(p) constructs the
+                new elements at p behind the old ones first and returns
+                their number, so its arguments may still refer to the
+                old ones, as with std::vector.
+             */
+
+            template<class F>
+            void grow(size_t n,F f) {
+                T    * p = static_cast<T*>(_mr->allocate(n*sizeof(T),alignof(T)));
+                size_t k;
+
+                try {
+                    k = f(p+_n);
+                } catch(...) {
+                    _mr->deallocate(p,n*sizeof(T),alignof(T));
+                    throw;
+                }
+
+                for(size_t i=0;i<_n;i++)
+                    construct(p+i,std::move(_p[i]));
+                std::destroy(_p,_p+_n);
+                release();
+
+                _p   = p;
+                _n  += k;
+                _cap = n;
+            }
+
+            /** Uses-allocator construction with _mr
+             */
+
+            template<class ... A>
+            void construct(T * p,A && ... a) {
+                std::pmr::polymorphic_allocator<T>(_mr).construct(p,std::forward<A>(a)...);
+            }
+
+            T * local() {
+                return reinterpret_cast<T*>(_local);
+            }
+
+            bool is_local() const {
+                return _p==reinterpret_cast<const T*>(_local);
+            }
+
+            void release() {
+                if(!is_local())
+                    _mr->deallocate(_p,_cap*sizeof(T),alignof(T));
+            }
+
+            void steal(SmallVector & o) noexcept {
+                if(o.is_local()) {
+                    for(;_n<o._n;_n++)
+                        construct(_p+_n,std::move(o._p[_n]));
+                    o.clear();
+                } else {
+                    _p   = o._p;
+                    _n   = o._n;
+                    _cap = o._cap;
+                    o._p   = o.local();
+                    o._n   = 0;
+                    o._cap = N;
+                }
+            }
+
+            alignas(T) unsigned char _local[N*sizeof(T)];
+            T *    _p;
+            size_t _n;
+            size_t _cap;
+            std::pmr::memory_resource * _mr;
+        };
+    }
+}
+
+#endif // PSTIFF_TOOLS_SMALL_VECTOR_H
@@ -23,38 +23,157 @@
 #ifndef PSTIFF_TOOLS_STRINGS_H
 #define PSTIFF_TOOLS_STRINGS_H
 
-#include <locale>
+#include <stdint.h>
 #include <string>
+#include <string_view>
 
 namespace PsTiff {
 
     namespace Tools {
+
+        /** Code point starting at si[i], advancing i behind it.
+            Photoshop keeps its names as UTF-16 so a pair of
+            surrogates gets combined; a lone one becomes U+FFFD.
+         */
+
+        inline
+        uint32_t next_code_point(std::wstring_view si,size_t & i) {
+            uint32_t c = (uint32_t)si[i++];
+
+            if(c>=0xd800 && c<0xdc00 && i<si.length() && (uint32_t)si[i]>=0xdc00 && (uint32_t)si[i]<0xe000)
+                return 0x10000 + ((c-0xd800)<<10) + ((uint32_t)si[i++]-0xdc00);
+
+            if((c>=0xd800 && c<0xe000) || c>0x10ffff)
+                return 0xfffd;
+
+            return c;
+        }
+
+        /** Code point of well formed UTF-8 starting at s[i],
+            advancing i behind it. Anything else, overlong forms and
+            surrogates included, becomes U+FFFD for a single byte.
+         */
+
+        inline
+        uint32_t next_utf8(std::string_view s,size_t & i) {
+            uint32_t c = (unsigned char)s[i++];
+            size_t   n;
+            uint32_t min;
+
+            if(c<0x80)
+                return c;
+
+            if(c>=0xc2 && c<0xe0) {
+                n = 1; min = 0x80;    c &= 0x1f;
+            } else if(c>=0xe0 && c<0xf0) {
+                n = 2; min = 0x800;   c &= 0x0f;
+            } else if(c>=0xf0 && c<0xf5) {
+                n = 3; min = 0x10000; c &= 0x07;
+            } else {
+                return 0xfffd;
+            }
+
+            if(s.length()-i<n)
+                return 0xfffd;
+
+            for(size_t k=0;k<n;k++) {
+                uint32_t b = (unsigned char)s[i+k];
+
+                if((b & 0xc0)!=0x80)
+                    return 0xfffd;
+
+                c = c<<6 | (b & 0x3f);
+            }
+
+            if(c<min || c>0x10ffff || (c>=0xd800 && c<0xe000))
+                return 0xfffd;
+
+            i += n;
+
+            return c;
+        }
+
+        /** Code point of the MacRoman character c, the 8 bit
+            encoding of the Pascal strings Photoshop writes
+         */
+
         inline
-        std::string from_wstring(const std::wstring & si,const std::string & ec="en_US.utf8")         {
-            typedef std::codecvt< wchar_t, char, std::mbstate_t > c_t;
-
-            std::locale loc(ec.c_str());
-
-            const c_t & f = std::use_facet<c_t>( loc );
-
-            std::string s;
-            {
-                std::mbstate_t st=mbstate_t();
-
-                const wchar_t *p = si.c_str();    // current start position in source
-                const wchar_t *e = p+si.length(); // one of end
-                const wchar_t *o = p;              // current end position reported by f.our
-
-                while(o!=e)
-                {
-                    static const int n = 30;
-                    static char c[n];
-                    char *d=NULL;
-                    f.out(st,p,e,o,c,c+n,d);
-                    s+=std::string(c,d-c);
-                    p=o;
-                }
+        uint32_t from_mac_roman(unsigned char c) {
+            static const uint16_t High[128] = {
+                0x00c4,0x00c5,0x00c7,0x00c9,0x00d1,0x00d6,0x00dc,0x00e1,0x00e0,0x00e2,0x00e4,0x00e3,0x00e5,0x00e7,0x00e9,0x00e8,
+                0x00ea,0x00eb,0x00ed,0x00ec,0x00ee,0x00ef,0x00f1,0x00f3,0x00f2,0x00f4,0x00f6,0x00f5,0x00fa,0x00f9,0x00fb,0x00fc,
+                0x2020,0x00b0,0x00a2,0x00a3,0x00a7,0x2022,0x00b6,0x00df,0x00ae,0x00a9,0x2122,0x00b4,0x00a8,0x2260,0x00c6,0x00d8,
+                0x221e,0x00b1,0x2264,0x2265,0x00a5,0x00b5,0x2202,0x2211,0x220f,0x03c0,0x222b,0x00aa,0x00ba,0x03a9,0x00e6,0x00f8,
+                0x00bf,0x00a1,0x00ac,0x221a,0x0192,0x2248,0x2206,0x00ab,0x00bb,0x2026,0x00a0,0x00c0,0x00c3,0x00d5,0x0152,0x0153,
+                0x2013,0x2014,0x201c,0x201d,0x2018,0x2019,0x00f7,0x25ca,0x00ff,0x0178,0x2044,0x20ac,0x2039,0x203a,0xfb01,0xfb02,
+                0x2021,0x00b7,0x201a,0x201e,0x2030,0x00c2,0x00ca,0x00c1,0x00cb,0x00c8,0x00cd,0x00ce,0x00cf,0x00cc,0x00d3,0x00d4,
+                0xf8ff,0x00d2,0x00da,0x00db,0x00d9,0x0131,0x02c6,0x02dc,0x00af,0x02d8,0x02d9,0x02da,0x00b8,0x02dd,0x02db,0x02c7
+            };
+
+            return c<0x80 ? c : High[c-0x80];
+        }
+
+        /** Number of bytes put_utf8() writes for si
+         */
+
+        inline
+        size_t utf8_size(std::wstring_view si) {
+            size_t n = 0;
+
+            for(size_t i=0;i<si.length();) {
+                uint32_t c = next_code_point(si,i);
+                n += c<0x80 ? 1 : c<0x800 ? 2 : c<0x10000 ? 3 : 4;
+            }
+
+            return n;
+        }
+
+        /** Write the code point c as UTF-8 to p, at most 4 bytes.
+            Returns the first byte behind it.
+         */
+
+        inline
+        char * put_utf8(char * p,uint32_t c) {
+            if(c<0x80) {
+                *p++ = (char)c;
+            } else if(c<0x800) {
+                *p++ = (char)(0xc0 | c>>6);
+                *p++ = (char)(0x80 | (c & 0x3f));
+            } else if(c<0x10000) {
+                *p++ = (char)(0xe0 | c>>12);
+                *p++ = (char)(0x80 | (c>>6 & 0x3f));
+                *p++ = (char)(0x80 | (c & 0x3f));
+            } else {
+                *p++ = (char)(0xf0 | c>>18);
+                *p++ = (char)(0x80 | (c>>12 & 0x3f));
+                *p++ = (char)(0x80 | (c>>6 & 0x3f));
+                *p++ = (char)(0x80 | (c & 0x3f));
             }
+
+            return p;
+        }
+
+        /** Write si as UTF-8 to p, utf8_size(si) bytes
+         */
+
+        inline
+        char * put_utf8(char * p,std::wstring_view si) {
+            for(size_t i=0;i<si.length();)
+                p = put_utf8(p,next_code_point(si,i));
+
+            return p;
+        }
+
+        /** UTF-8 of si. No locale is involved, which is costly to
+            construct and may not even be installed.
+         */
+
+        inline
+        std::string from_wstring(std::wstring_view si) {
+            std::string s(utf8_size(si),'\0');
+
+            put_utf8(&s[0],si);
+
             return s;
         }
     }
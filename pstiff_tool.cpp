@@ -20,17 +20,37 @@
 
 #include "tiffio.h"
 #include "pstiff/Resource.h"
+#include "pstiff/ResourceDecoder.h"
+#include "pstiff/TiffFormat.h"
+#include "pstiff/TiffWalker.h"
+#include "pstiff/PsdReader.h"
+#include "pstiff/JpegReader.h"
+#include "pstiff/Query.h"
+#include "pstiff/io/mapped_file.h"
+#include "pstiff/io/memory_tiff.h"
+#include "pstiff/io/range_reader.h"
+#include "pstiff/io/batch_scanner.h"
+#include "pstiff/io/page_processor.h"
+#include "pstiff/io/corpus_scanner.h"
+#include "pstiff/io/emitter.h"
+#include "pstiff/io/index_cache.h"
+#include "pstiff/io/payload_store.h"
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <set>
 
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <pstiff/io/hex_dump.h>
 #include <getopt.h>
+#include <sys/stat.h>
 
 #define TIFFTAG_PHOTOSHOP_DDB 37724
 
@@ -43,7 +63,7 @@ void _Warning(const char* module, const char* fmt, va_list ap) {
         ss << module << ":";
 
     static const int n=100;
-    static char b[n];
+    char b[n];
 
     if(vsnprintf(b, n,fmt, ap)>=n)
         ss << b << "...";
@@ -62,7 +82,7 @@ void _Error(const char* module, const char* fmt, va_list ap)
     if (module != NULL)
         ss << module << ":";
     static const int n=100;
-    static char b[n];
+    char b[n];
 
     if(vsnprintf(b, n,fmt, ap)>=n)
         ss << b << "...";
@@ -75,42 +95,111 @@ void _Error(const char* module, const char* fmt, va_list ap)
 typedef unsigned char byte_t;
 
 
-void ParsePhotoshop(const PsTiff::Byte_t * p,int n,bool raw=false,std::ostream &os=std::cout) {
+/** --format, Text being the dump meant for humans
+ */
 
-    const PsTiff::Byte_t *p0=p;
+typedef enum {
+    Text,
+    Ndjson,
+    Binary
+} Format_t;
 
-    while(p<p0+n) {
+static Format_t Format = Text;
 
-        PsTiff::Resource r(p);
-        bool dumped = false;
-        if(r.get_id()==PsTiff::ResourceId::AlternateSpotColors) {
-            os << " -A " << PsTiff::SpotColorResource(p) << std::endl;
-        } else if(r.get_id()==PsTiff::ResourceId::AlphaNames) {
-            os << " -B " << PsTiff::AlphaNamesResource(p) << std::endl;
-        } else if(r.get_id()==PsTiff::ResourceId::UnicodeAlphaNames) {
-            os << " -C " << PsTiff::UnicodeAlphaNamesResource(p) << std::endl;
-        } else if(r.get_id()==PsTiff::ResourceId::AlphaIdentifiers) {
-            os << " -D " << PsTiff::AlphaIdentifiersResource(p) << std::endl;
-        } else if(r.get_id()==PsTiff::ResourceId::AlphaIdentifiers) {
-            os << " -E " << PsTiff::AlphaIdentifiersResource(p) << std::endl;
-        } else if(r.get_id() == PsTiff::ResourceId::VersionInfo) {
-            os << " -V " << PsTiff::VersionInfoResource(p) << std::endl;
-        } else if(raw) {
-            dumped = true;
-            os << " -? '"<< r.get_name() << "'::0x" << std::hex << std::setfill('0') << std::setw(4)
-               << r.get_id() << std::dec << std::endl
-               << PsTiff::IO::hex_dump(r.get_data(),r.get_size())
-               << std::endl;
+/** Emitter of this thread for Format, its buffer is reused from
+    record to record
+ */
+
+PsTiff::IO::Emitter & GetEmitter() {
+    thread_local std::unique_ptr<PsTiff::IO::Emitter> e;
+
+    if(!e)
+        e = PsTiff::IO::Emitter::create(Format==Binary ? PsTiff::IO::Emitter::Binary : PsTiff::IO::Emitter::Ndjson);
+
+    return *e;
+}
+
+/** One record for page page of path in the structured formats
+ */
+
+void EmitPhotoshop(const std::string & path,size_t page,const PsTiff::Byte_t * p,size_t n,const PsTiff::ResourceDecoder & dec,bool raw,std::ostream & os) {
+    PsTiff::IO::Emitter &    e = GetEmitter();
+    PsTiff::ParseDiagnostics diag;
+
+    e.begin_record();
+    e.key("path").string(path);
+    e.key("page").uint(page);
+    e.key("resources").begin_array();
+
+    dec.try_decode(p,n,[&](const PsTiff::ResourceView & v,PsTiff::ResourceDecoder::Result_t r) {
+        PsTiff::ResourceId::Enum_t id = v.get_id().to_enum();
+
+        if(!dec.has(id) && !raw)
+            return;
+
+        e.begin_object();
+        e.key("id").uint(v.get_id_value());
+        e.key("type").string(PsTiff::ResourceId::to_name(id));
+        e.key("name").mac_string(v.get_name());
+        e.key("size").uint(v.get_data_size());
+
+        if(dec.has(id))
+            r->emit(e);
+
+        if(raw)
+            e.key("data").bytes(v.get_data(),v.get_data_size());
+
+        e.end_object();
+    },PsTiff::Resync,&diag);
+
+    e.end_array();
+
+    if(diag.size()!=0) {
+        e.key("errors").begin_array();
+
+        for(const PsTiff::ParseStatus & s : diag) {
+            e.begin_object();
+            e.key("message").string(s.get_message());
+            e.key("offset").uint(s.get_offset());
+            e.end_object();
         }
-        if(!dumped && raw)
-            os << PsTiff::IO::hex_dump(r.get_data(),r.get_size()) << std::endl;
 
-        p += r.get_size();
+        e.end_array();
+        e.key("dropped").uint(diag.get_dropped());
     }
-    
-    if(p-p0 != n) {
-        throw std::runtime_error("failed to parse PostScript Tag");
+
+    e.end_record();
+    e.write(os);
+}
+
+void ParsePhotoshop(const std::string & path,size_t page,const PsTiff::Byte_t * p,int n,const PsTiff::ResourceDecoder & dec,bool raw=false,std::ostream &os=std::cout) {
+
+    if(Format!=Text) {
+        EmitPhotoshop(path,page,p,n,dec,raw,os);
+        return;
     }
+
+    PsTiff::ParseDiagnostics diag;
+
+    dec.try_decode(p,n,[&](const PsTiff::ResourceView & v,PsTiff::ResourceDecoder::Result_t r) {
+        PsTiff::ResourceId::Enum_t e = v.get_id().to_enum();
+        if(dec.has(e)) {
+            os << " -" << PsTiff::ResourceId::to_name(e) << " " << *r << '\n';
+            if(raw)
+                os << PsTiff::IO::hex_dump(v.get_data(),v.get_data_size()) << '\n';
+        } else if(raw) {
+            os << " -? '"<< v.get_name() << "'::0x" << std::hex << std::setfill('0') << std::setw(4)
+               << v.get_id_value() << std::dec << '\n'
+               << PsTiff::IO::hex_dump(v.get_data(),v.get_data_size())
+               << '\n';
+        }
+    },PsTiff::Resync,&diag);
+
+    for(const PsTiff::ParseStatus & s : diag)
+        os << " ## skipped block: " << s.get_message() << " @" << s.get_offset() << '\n';
+
+    if(diag.get_dropped()!=0)
+        os << " ## " << diag.get_dropped() << " more errors" << '\n';
 }
 
 void ParsePhotoshopDDB(const byte_t * p,int n,std::ostream &os=std::cout) {
@@ -132,32 +221,685 @@ void ParsePhotoshopDDB(const byte_t * p,int n,std::ostream &os=std::cout) {
 }
 
 
-static const std::string Usage = "Usage: [--raw] pstiff_dump tiff-file";
+static const std::string Usage = "Usage: [--raw] [--mmap] [--range [--latency=us]] [--jobs=n] [--only=id,...] pstiff_dump tiff-file|psd-file|jpeg-file|-\n"
+                                  "       [--raw] [--only=id,...] pstiff_dump --batch tiff-file...\n"
+                                  "       [--raw] [--jobs=n] [--window=n] [--list=file|-]... [--index=file [--prune]] [--store=pack [--min-payload=n]] [--where=query] [--only=id,...] pstiff_dump --scan [file|dir|-]...\n"
+                                  "       --store=pack --users=hash|--refs=file pstiff_dump\n"
+                                  "       --format=text|ndjson|bin goes with all of them";
+
+/** Print the Image Resources of the PSD or PSB file at path, read
+    from memory if span isn't empty. Returns -1 if it's no PSD file.
+ */
+
+int ParsePsd(const std::string & path,const PsTiff::Span_t & span,const PsTiff::ResourceDecoder & dec,bool raw,
+             std::ostream & os=std::cout,std::ostream & es=std::cerr) {
+    PsTiff::PsdReader           psd;
+    PsTiff::PsdReader::Header_t h;
+    PsTiff::Buffer_t            b;
+    const PsTiff::Byte_t      * p = NULL;
+    uint64_t                    n = 0;
+    PsTiff::ParseStatus         s;
+
+    if(!span.empty()) {
+        uint64_t off;
+        s = PsTiff::PsdReader::find_resources(span.data(),span.size(),h,off,n);
+        p = span.data()+off;
+    } else if(psd.open(path)) {
+        s = psd.read_resources(b);
+        p = b.get();
+        n = psd.get_resources_size();
+    } else {
+        return -1;
+    }
+
+    if(s.get_code()==PsTiff::ParseStatus::BadPsdHeader)
+        return -1;
+
+    if(!s) {
+        es << "'" << path << "': " << s.get_message() << " @" << s.get_offset() << std::endl;
+        return 1;
+    }
+
+    ParsePhotoshop(path,0,p,n,dec,raw,os);
+
+    return 0;
+}
+
+/** Print the Photoshop resources of the JPEG file at path, read
+    from memory if span isn't empty. Returns -1 if it's no JPEG file.
+ */
+
+int ParseJpeg(const std::string & path,const PsTiff::Span_t & span,const PsTiff::ResourceDecoder & dec,bool raw,
+              std::ostream & os=std::cout,std::ostream & es=std::cerr) {
+    PsTiff::JpegReader          jpeg;
+    PsTiff::JpegReader::Parts_t parts;
+    std::vector<PsTiff::Byte_t> joined;
+    PsTiff::Buffer_t            b;
+    const PsTiff::Byte_t      * p = NULL;
+    uint64_t                    n = 0;
+    PsTiff::ParseStatus         s;
+
+    if(!span.empty()) {
+        s = PsTiff::JpegReader::find_resources(span.data(),span.size(),parts);
+
+        for(const PsTiff::JpegReader::Part_t & r : parts)
+            joined.insert(joined.end(),span.data()+r.offset,span.data()+r.offset+r.size);
+
+        p = joined.data();
+        n = joined.size();
+    } else if(jpeg.open(path)) {
+        s = jpeg.read_resources(b);
+        p = b.get();
+        n = jpeg.get_resources_size();
+    } else {
+        return -1;
+    }
+
+    if(s.get_code()==PsTiff::ParseStatus::BadJpegHeader)
+        return -1;
+
+    if(!s) {
+        es << "'" << path << "': " << s.get_message() << " @" << s.get_offset() << std::endl;
+        return 1;
+    }
+
+    ParsePhotoshop(path,0,p,n,dec,raw,os);
+
+    return 0;
+}
+
+/** Walk the directories of the mapped file ourselves instead of
+    letting libtiff read each of them completely.
+ */
+
+int ParseMapped(const std::string & path,const PsTiff::Span_t & span,const PsTiff::ResourceDecoder & dec,bool raw,
+                std::ostream & os=std::cout,std::ostream & es=std::cerr) {
+    PsTiff::TiffWalker  w(span);
+    PsTiff::ParseStatus s = w.for_each([&](const PsTiff::TiffWalker::Directory_t & d) {
+        if(!d.photoshop.empty())
+            ParsePhotoshop(path,d.index,d.photoshop.data.data(),d.photoshop.data.size(),dec,raw,os);
+        return true;
+    });
+
+    if(!s) {
+        es << "'" << path << "': " << s.get_message() << " @" << s.get_offset() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Parse the pages of path with jobs threads (0 for one per core)
+    and print them in page order. Returns -1 if path can't be mapped.
+ */
+
+int ParsePages(const std::string & path,const PsTiff::ResourceDecoder & dec,bool raw,unsigned jobs) {
+    PsTiff::IO::PageProcessor::Options_t o;
+
+    if(jobs!=0)
+        o.workers = jobs;
+
+    PsTiff::IO::PageProcessor pages(o);
+
+    if(!pages.open(path))
+        return -1;
+
+    PsTiff::ParseStatus s = pages.run([&](size_t page,TIFF * tif) {
+        std::stringstream ss;
+        uint32_t          n;
+        PsTiff::Byte_t  * data;
+
+        if(TIFFGetField(tif,TIFFTAG_PHOTOSHOP,&n,&data)==1)
+            ParsePhotoshop(path,page,data,n,dec,raw,ss);
+
+        return ss.str();
+    },[](size_t,const std::string & s) {
+        std::cout << s;
+    });
+
+    if(!s) {
+        std::cerr << "'" << path << "': " << s.get_message() << " @" << s.get_offset() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/** Read all files at once. Pages are printed as their Photoshop
+    blocks arrive, not in the order of the files.
+ */
+
+int ParseBatch(const std::vector<std::string> & paths,const PsTiff::ResourceDecoder & dec,bool raw) {
+    std::mutex               m;
+    PsTiff::IO::BatchScanner scanner;
+
+    const PsTiff::IO::BatchScanner::Stats_t & st = scanner.scan(paths,[&](const PsTiff::IO::BatchScanner::Item_t & i) {
+        std::stringstream ss;
+
+        if(i.error!=0) {
+            std::lock_guard<std::mutex> l(m);
+            std::cerr << "'" << *i.path << "': " << ::strerror(i.error) << std::endl;
+            return;
+        }
+
+        if(!i.status) {
+            std::lock_guard<std::mutex> l(m);
+            std::cerr << "'" << *i.path << "': " << i.status.get_message() << " @" << i.status.get_offset() << std::endl;
+            return;
+        }
+
+        if(Format==Text)
+            ss << *i.path << ":" << i.page << '\n';
+        ParsePhotoshop(*i.path,i.page,i.data.data(),i.data.size(),dec,raw,ss);
+
+        std::lock_guard<std::mutex> l(m);
+        std::cout << ss.str();
+    });
+
+    std::cerr << "## " << st.files << " files, " << st.failed << " failed, "
+              << st.requests << " requests, " << st.bytes << " bytes"
+              << (scanner.is_uring() ? " (io_uring)" : " (threads)") << std::endl;
+
+    return st.failed!=0 ? 1 : 0;
+}
+
+/** --min-payload, resources smaller than this aren't worth a payload
+    of their own
+ */
+
+static size_t MinPayload = 1024;
+
+/** Print the files of store using the payload h
+ */
+
+int PrintUsers(const PsTiff::IO::PayloadStore & store,PsTiff::IO::PayloadStore::Hash_t h) {
+    for(const std::string & path : store.get_users(h)) {
+        if(Format==Text) {
+            std::cout << path << '\n';
+            continue;
+        }
+
+        PsTiff::IO::Emitter & e = GetEmitter();
+
+        e.begin_record();
+        e.key("path").string(path);
+        e.end_record();
+        e.write(std::cout);
+    }
+
+    return 0;
+}
+
+/** Print the payloads of path kept in store. Returns 1 if there's no
+    record of path.
+ */
+
+int PrintRefs(const PsTiff::IO::PayloadStore & store,const std::string & path) {
+    PsTiff::IO::PayloadStore::Refs_t refs;
+
+    if(!store.get_refs(path,refs)) {
+        std::cerr << "'" << path << "': not in store" << std::endl;
+        return 1;
+    }
+
+    for(const PsTiff::IO::PayloadStore::Ref_t & r : refs) {
+        PsTiff::Span_t s;
+
+        store.get(r.hash,s);
+
+        if(Format==Text) {
+            std::cout << r.page << " " << PsTiff::ResourceId(r.id).get_name()
+                      << " 0x" << std::hex << std::setfill('0') << std::setw(4) << r.id
+                      << " " << std::setw(16) << r.hash << std::dec << std::setfill(' ')
+                      << " " << s.size() << '\n';
+            continue;
+        }
+
+        PsTiff::IO::Emitter & e = GetEmitter();
+
+        e.begin_record();
+        e.key("path").string(path);
+        e.key("page").uint(r.page);
+        e.key("id").uint(r.id);
+        e.key("hash").uint(r.hash);
+        e.key("size").uint(s.size());
+        e.end_record();
+        e.write(std::cout);
+    }
+
+    return 0;
+}
+
+/** What scanning one file printed, handed on in input order. Files
+    read for an index come with their record; the summaries of its
+    pages point into summaries.
+ */
+
+struct Scanned_t {
+    Scanned_t() : failed(false),skipped(false),cached(false),keyed(false),indexed(false),matched(true) {
+    }
+
+    std::string                        out;
+    std::string                        err;
+    bool                               failed;
+    bool                               skipped;  //< neither TIFF, PSD nor JPEG
+    bool                               cached;   //< answered from the index
+    bool                               keyed;    //< key is the one of the file
+    bool                               indexed;  //< to be added to the index
+    bool                               matched;  //< by --where, printed
+    PsTiff::IO::IndexCache::Key_t      key;
+    PsTiff::IO::IndexCache::Record_t   record;
+    std::vector<PsTiff::Byte_t>        summaries;
+};
+
+/** A resource blob found by a scan: page, its place in the file and
+    where it is in memory
+ */
+
+struct Blob_t {
+    uint32_t               page;
+    uint64_t               offset;
+    uint64_t               length;
+    const PsTiff::Byte_t * p;
+    size_t                 size;
+};
+
+/** Print the resources of one file of a scan. Everything runs on the
+    mapped bytes, so libtiff isn't involved. Files index knows about
+    don't get read at all; without --raw the typed resources kept
+    there are all that gets printed anyway. With a store every file
+    gets read, its resources of at least MinPayload bytes go there. With
+    where only files with a page matching it get printed.
+ */
+
+Scanned_t ScanFile(const std::string & path,const PsTiff::ResourceDecoder & dec,bool raw,const PsTiff::IO::IndexCache * index,
+                   PsTiff::IO::PayloadStore * store,const PsTiff::Query * where) {
+    typedef PsTiff::IO::IndexCache IndexCache;
+
+    Scanned_t              r;
+    PsTiff::IO::MappedFile file;
+    std::stringstream      os;
+    std::stringstream      es;
+    struct stat            st;
+
+    r.keyed   = index!=NULL && IndexCache::get_key(path,r.key);
+    r.indexed = r.keyed && !raw;
+
+    // The summaries kept in the index do for queries on typed resources.
+    // A store needs every file read to get its payloads.
+
+    if(r.indexed && store==NULL && (where==NULL || where->is_typed()) && index->find(r.key,r.record)) {
+        r.indexed = false;
+        r.cached  = true;
+        r.skipped = r.record.type==IndexCache::Other;
+        r.matched = !r.skipped && where==NULL;
+
+        for(const IndexCache::Page_t & pg : r.record.pages) {
+            if(!r.matched)
+                r.matched = where->match(pg.summary.data(),pg.summary.size());
+        }
+
+        if(r.matched && Format==Text)
+            os << path << '\n';
+
+        for(const IndexCache::Page_t & pg : r.record.pages) {
+            if(r.matched)
+                ParsePhotoshop(path,pg.page,pg.summary.data(),pg.summary.size(),dec,raw,os);
+        }
+
+        r.out = os.str();
+        r.record.pages.clear();
+
+        return r;
+    }
+
+    if(!file.open(path)) {
+        r.matched = false;
+
+        if(::stat(path.c_str(),&st)==0 && S_ISREG(st.st_mode) && st.st_size==0) {
+            r.skipped = true;
+        } else {
+            r.failed  = true;
+            r.indexed = false;
+            r.err     = "Unable to map '" + path + "'\n";
+        }
+        return r;
+    }
+
+    PsTiff::Span_t                   span = file.get_span();
+    PsTiff::PsdReader::Header_t      h;
+    PsTiff::JpegReader::Parts_t      parts;
+    std::vector<PsTiff::Byte_t>      joined;
+    uint64_t                         off;
+    uint64_t                         len;
+    PsTiff::ParseStatus              s;
+    std::vector<size_t>              ends;
+    PsTiff::IO::PayloadStore::Refs_t refs;
+    std::vector<Blob_t>              blobs;
+
+    auto page = [&](uint32_t n,uint64_t o,uint64_t l,const PsTiff::Byte_t * p,size_t size) {
+        blobs.push_back(Blob_t{n,o,l,p,size});
+    };
+
+    if((s = PsTiff::PsdReader::find_resources(span.data(),span.size(),h,off,len)).get_code()!=PsTiff::ParseStatus::BadPsdHeader) {
+        r.record.type = IndexCache::Psd;
+
+        if(s)
+            page(0,off,len,span.data()+off,len);
+    } else if((s = PsTiff::JpegReader::find_resources(span.data(),span.size(),parts)).get_code()!=PsTiff::ParseStatus::BadJpegHeader) {
+        r.record.type = IndexCache::Jpeg;
+
+        for(const PsTiff::JpegReader::Part_t & p : parts)
+            joined.insert(joined.end(),span.data()+p.offset,span.data()+p.offset+p.size);
+
+        if(s)
+            page(0,parts.empty() ? 0 : parts[0].offset,parts.size()==1 ? parts[0].size : 0,joined.data(),joined.size());
+    } else {
+        PsTiff::TiffFormat f;
+        uint64_t           first;
+
+        s = f.read_header(span.data(),span.size(),first);
+
+        if(s.get_code()==PsTiff::ParseStatus::BadTiffHeader && s.get_offset()<=2) {
+            r.skipped = true;
+            r.matched = false;
+            r.record  = IndexCache::Record_t();
+            return r;
+        }
+
+        r.record.type = IndexCache::Tiff;
+
+        s = PsTiff::TiffWalker(span).for_each([&](const PsTiff::TiffWalker::Directory_t & d) {
+            if(!d.photoshop.empty())
+                page(d.index,d.photoshop.offset,d.photoshop.data.size(),d.photoshop.data.data(),d.photoshop.data.size());
+            return true;
+        });
+    }
+
+    if(!s) {
+        es << "'" << path << "': " << s.get_message() << " @" << s.get_offset() << '\n';
+        r.failed  = true;
+        r.indexed = false;
+    }
+
+    // Decide on the file before printing any of it
+
+    r.matched = where==NULL;
+
+    for(const Blob_t & b : blobs) {
+        if(!r.matched)
+            r.matched = where->match(b.p,b.size);
+    }
+
+    if(r.matched && Format==Text)
+        os << path << '\n';
+
+    // Print the blobs and keep their summaries and payloads
+
+    for(const Blob_t & b : blobs) {
+        if(r.matched)
+            ParsePhotoshop(path,b.page,b.p,b.size,dec,raw,os);
+
+        if(store!=NULL)
+            store->put_resources(b.page,b.p,b.size,MinPayload,refs);
+
+        if(!r.indexed)
+            continue;
+
+        IndexCache::Page_t pg;
+
+        pg.page   = b.page;
+        pg.offset = b.offset;
+        pg.size   = b.length;
+
+        IndexCache::summarize(b.p,b.size,r.summaries);
+
+        r.record.pages.push_back(pg);
+        ends.push_back(r.summaries.size());
+    }
+
+    if(store!=NULL && !r.failed)
+        store->add_file(path,refs);
+
+    // The summaries have moved while they grew
+
+    for(size_t i=0;i<r.record.pages.size();i++) {
+        size_t b = i==0 ? 0 : ends[i-1];
+        r.record.pages[i].summary = PsTiff::Span_t(r.summaries.data()+b,ends[i]-b);
+    }
+
+    r.out = os.str();
+    r.err = es.str();
+
+    return r;
+}
+
+/** Scan the files and directories in paths and the lists of paths in
+    lists on jobs threads (0 for one per core), printing in input
+    order. With an index (not empty) files which haven't changed since
+    the last scan are answered from it and the others added; prune
+    drops the entries of the files the scan didn't come across. With a
+    store payloads go there, with where only matching files get printed.
+ */
+
+int ParseScan(const std::vector<std::string> & paths,const std::vector<std::string> & lists,const PsTiff::ResourceDecoder & dec,bool raw,
+              unsigned jobs,size_t window,const std::string & index,bool prune,PsTiff::IO::PayloadStore * store,const PsTiff::Query * where) {
+    PsTiff::IO::IndexCache cache;
+
+    if(!index.empty())
+        cache.open(index);
+
+    PsTiff::IO::CorpusScanner::Options_t o;
+
+    if(jobs!=0)
+        o.workers = jobs;
+
+    if(window!=0)
+        o.window = window;
+
+    PsTiff::IO::CorpusScanner scanner(o);
+
+    for(const std::string & p : paths) {
+        if(p=="-")
+            scanner.add_list(p);
+        else
+            scanner.add(p);
+    }
+
+    for(const std::string & l : lists)
+        scanner.add_list(l);
+
+    size_t failed  = 0;
+    size_t skipped = 0;
+    size_t cached  = 0;
+    size_t matched = 0;
+    size_t files   = scanner.run([&](const std::string & path) {
+        return ScanFile(path,dec,raw,index.empty() ? NULL : &cache,store,where);
+    },[&](const std::string &,const Scanned_t & r) {
+        std::cout << r.out;
+        std::cerr << r.err;
+
+        failed  += r.failed;
+        skipped += r.skipped;
+        cached  += r.cached;
+        matched += r.matched;
+
+        if(r.indexed)
+            cache.add(r.key,r.record);
+        else if(r.keyed)
+            cache.keep(r.key);
+    });
+
+    if(!index.empty())
+        cache.commit(prune);
+
+    std::cerr << "## " << files << " files, " << failed << " failed, " << skipped << " skipped";
+
+    if(!index.empty())
+        std::cerr << ", " << cached << " from index";
+
+    if(store!=NULL)
+        std::cerr << ", " << store->size() << " payloads, " << store->get_saved() << " bytes shared";
+
+    if(where!=NULL)
+        std::cerr << ", " << matched << " matched";
+
+    std::cerr << std::endl;
+
+    return failed!=0 ? 1 : 0;
+}
 
 int main(int argc, char* argv[]) {
     TIFF *in, *out;
 
     bool raw=false;
+    bool mapped=false;
+    bool ranged=false;
+    bool batch=false;
+    bool scan=false;
+    size_t window=0;
+    std::string index;
+    bool prune=false;
+    std::string store;
+    std::string users;
+    std::string refs;
+    std::unique_ptr<PsTiff::Query> where;
+    std::vector<std::string> lists;
+    unsigned jobs=0;
+    PsTiff::IO::RangeReader::Options_t range_opts;
+    PsTiff::ResourceDecoder dec;
+    std::vector<PsTiff::ResourceId::Enum_t> only;
 
     while(true) {
         static struct option lo[] = {
             {"verbose", no_argument,       0,  'v' },
             {"raw",     no_argument,       0,  'r' },
+            {"only",    required_argument, 0,  'o' },
+            {"mmap",    no_argument,       0,  'm' },
+            {"range",   no_argument,       0,  'n' },
+            {"latency", required_argument, 0,  'l' },
+            {"batch",   no_argument,       0,  'b' },
+            {"jobs",    required_argument, 0,  'j' },
+            {"format",  required_argument, 0,  'f' },
+            {"scan",    no_argument,       0,  's' },
+            {"list",    required_argument, 0,  'L' },
+            {"window",  required_argument, 0,  'w' },
+            {"index",   required_argument, 0,  'i' },
+            {"prune",   no_argument,       0,  'p' },
+            {"store",   required_argument, 0,  'S' },
+            {"users",   required_argument, 0,  'U' },
+            {"refs",    required_argument, 0,  'R' },
+            {"min-payload", required_argument, 0,  'P' },
+            {"where",   required_argument, 0,  'W' },
             {0,         0,                 0,  0 }
         };
 
         int oidx;
-        int c = ::getopt_long(argc, argv, "vr", lo, &oidx);
+        int c = ::getopt_long(argc, argv, "vrmnbspl:o:j:L:w:f:i:S:U:R:P:W:", lo, &oidx);
 
         if (c == -1)
             break;
 
         switch(c) {
 
+        case 'o':
+            {
+                std::stringstream ss(optarg);
+                std::string n;
+                while(std::getline(ss,n,',')) {
+                    PsTiff::ResourceId::Enum_t e = PsTiff::ResourceId::from_name(n);
+                    if(e==PsTiff::ResourceId::Unknown) {
+                        std::cerr << "unknown resource '" << n << "'" << std::endl;
+                        ::exit(1);
+                    }
+                    only.push_back(e);
+                }
+            }
+            break;
+
+        case 'm':
+            mapped=true;
+            break;
+
+        case 'n':
+            ranged=true;
+            break;
+
+        case 'l':
+            range_opts.latency = std::chrono::microseconds(::atol(optarg));
+            break;
+
+        case 'b':
+            batch=true;
+            break;
+
+        case 'j':
+            jobs=::atoi(optarg);
+            break;
+
+        case 's':
+            scan=true;
+            break;
+
+        case 'L':
+            lists.push_back(optarg);
+            break;
+
+        case 'w':
+            window=::atol(optarg);
+            break;
+
+        case 'i':
+            index=optarg;
+            break;
+
+        case 'p':
+            prune=true;
+            break;
+
+        case 'S':
+            store=optarg;
+            break;
+
+        case 'U':
+            users=optarg;
+            break;
+
+        case 'R':
+            refs=optarg;
+            break;
+
+        case 'P':
+            MinPayload=::atol(optarg);
+            break;
+
+        case 'W':
+            try {
+                where.reset(new PsTiff::Query(optarg));
+            } catch(const std::exception & ex) {
+                std::cerr << ex.what() << std::endl;
+                ::exit(1);
+            }
+            break;
+
+        case 'f':
+            if(::strcmp(optarg,"text")==0) {
+                Format=Text;
+            } else if(::strcmp(optarg,"ndjson")==0) {
+                Format=Ndjson;
+            } else if(::strcmp(optarg,"bin")==0) {
+                Format=Binary;
+            } else {
+                std::cerr << "unknown format '" << optarg << "'" << std::endl;
+                ::exit(1);
+            }
+            break;
+
         case 'r':
             raw=true;
+            break;
+
         case 'v':
-            std::cerr << "option '" << c << "'" << std::endl;
             break;
 
         default:
@@ -168,22 +910,123 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if(!only.empty()) {
+        dec.select_none();
+        dec.select(only.begin(),only.end());
+    }
+
+    if(!raw)
+        dec.select_registered();
+
+    // Records go out as the buffer of cout fills up, not line by line
+
+    std::ios::sync_with_stdio(false);
+
     TIFFSetErrorHandler(_Error);
     TIFFSetWarningHandler(_Warning);
 
+    if(batch)
+        return ParseBatch(std::vector<std::string>(argv+optind,argv+argc),dec,raw);
+
+    if(scan && argc==optind && lists.empty()) {
+        std::cerr << Usage << std::endl;
+        ::exit(1);
+    }
+
+    // Questions to the store don't look at any file
+
+    if(!users.empty() || !refs.empty()) {
+        PsTiff::IO::PayloadStore s;
+
+        if(store.empty() || !s.open(store,false)) {
+            std::cerr << "Unable to open store '" << store << "'" << std::endl;
+            ::exit(1);
+        }
+
+        if(!users.empty())
+            return PrintUsers(s,::strtoull(users.c_str(),NULL,16));
+
+        return PrintRefs(s,refs);
+    }
+
+    if(scan) {
+        PsTiff::IO::PayloadStore s;
 
-    std::cerr << argc - optind << std::endl;
+        if(!store.empty() && !s.open(store)) {
+            std::cerr << "Unable to open store '" << store << "'" << std::endl;
+            ::exit(1);
+        }
+
+        return ParseScan(std::vector<std::string>(argv+optind,argv+argc),lists,dec,raw,jobs,window,index,prune,store.empty() ? NULL : &s,where.get());
+    }
 
-    if(argc!=1)
+    if(argc-optind!=1) {
         std::cerr << Usage << std::endl;
-    
-    if((in = TIFFOpen(argv[optind], "r"))==NULL)
+        ::exit(1);
+    }
+
+    // '-' reads the whole TIFF from stdin and works on it in memory
+
+    std::string                             path = argv[optind];
+    std::vector<PsTiff::Byte_t>             stdin_data;
+    PsTiff::IO::MappedFile                  file;
+    std::unique_ptr<PsTiff::IO::MemoryTiff> memory;
+    PsTiff::IO::RangeReader                 range;
+    PsTiff::Span_t                          span;
+
+    if(path=="-") {
+        stdin_data.assign(std::istreambuf_iterator<char>(std::cin),std::istreambuf_iterator<char>());
+        span = PsTiff::Span_t(stdin_data.data(),stdin_data.size());
+    } else if(mapped) {
+        if(!file.open(path)) {
+            std::cerr << "Unable to map '" << path << "'" << std::endl;
+            ::exit(1);
+        }
+        span = file.get_span();
+    }
+
+    // PSD and PSB files have the same resources, in a section of their own
+
+    int psd = ParsePsd(path,span,dec,raw);
+
+    if(psd>=0)
+        return psd;
+
+    // So do JPEG files, in their APP13 segments
+
+    int jpeg = ParseJpeg(path,span,dec,raw);
+
+    if(jpeg>=0)
+        return jpeg;
+
+    if(mapped)
+        return ParseMapped(path,span,dec,raw);
+
+    // Files which can't be mapped, e.g. pipes, get read page by page
+
+    if(path!="-" && !ranged) {
+        int r = ParsePages(path,dec,raw,jobs);
+
+        if(r>=0)
+            return r;
+    }
+
+    if(path=="-") {
+        memory.reset(new PsTiff::IO::MemoryTiff(span.data(),span.size()));
+        in = memory->get();
+    } else if(ranged) {
+        in = range.open(path,range_opts) ? range.open_tiff(path.c_str()) : NULL;
+    } else {
+        in = TIFFOpen(path.c_str(), "r");
+    }
+
+    if(in==NULL)
     {
-        std::cerr << "Unable to open '" << argv[1] << "'" << std::endl;
+        std::cerr << "Unable to open '" << path << "'" << std::endl;
         ::exit(1);
     }
 
-    int n=0;
+    int page=0;
 
     do {
         {
@@ -191,7 +1034,7 @@ int main(int argc, char* argv[]) {
             byte_t *data;
 
             if(TIFFGetField(in,TIFFTAG_PHOTOSHOP,&n,&data)==1) {
-                ParsePhotoshop(data,n,raw,std::cout);
+                ParsePhotoshop(path,page,data,n,dec,raw,std::cout);
             }
 #if 0
             if(TIFFGetField(in,TIFFTAG_PHOTOSHOP_DDB,&n,&data)==1) {
@@ -209,10 +1052,19 @@ int main(int argc, char* argv[]) {
 #endif
 
         }
-        n++;
+        page++;
     } while (TIFFReadDirectory(in));
 
-    TIFFClose(in);
+    if(memory)
+        memory->close();
+    else
+        TIFFClose(in);
+
+    if(ranged)
+        std::cerr << "## " << range.get_stats().requests << " requests, "
+                  << range.get_stats().bytes << " bytes, "
+                  << range.get_stats().hits << " hits, "
+                  << range.get_stats().misses << " misses" << std::endl;
 
     return 0;
 }